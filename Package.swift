@@ -13,6 +13,12 @@ let package = Package(
     targets: [
         .target(name: "CMustache"),
         .target(name: "Mustache", dependencies: ["CMustache"]),
-        .testTarget(name: "MustacheTests", dependencies: ["Mustache"]),
+        .target(name: "CMustacheBench", dependencies: ["CMustache"]),
+        .target(name: "CMustacheCompiler", dependencies: ["CMustache"]),
+        .target(name: "CMustacheTestSupport", dependencies: ["CMustache"], path: "Tests/CMustacheTestSupport"),
+        .target(name: "CMustacheAllocationSupport", dependencies: ["CMustache"], path: "Tests/CMustacheAllocationSupport"),
+        .testTarget(name: "MustacheTests", dependencies: ["Mustache", "CMustache"]),
+        .testTarget(name: "CMustacheTests", dependencies: ["CMustacheTestSupport"]),
+        .testTarget(name: "CMustacheAllocationTests", dependencies: ["CMustacheAllocationSupport"]),
     ]
 )
@@ -0,0 +1,36 @@
+// swift-tools-version:5.6
+import PackageDescription
+
+let package = Package(
+    name: "mustache",
+    platforms: [
+       .macOS(.v10_14)
+    ],
+    products: [
+        .library(name: "Mustache", targets: ["Mustache"]),
+        .plugin(name: "MustacheGeneratorPlugin", targets: ["MustacheGeneratorPlugin"]),
+    ],
+    dependencies: [ ],
+    targets: [
+        .target(name: "CMustache"),
+        .target(name: "Mustache", dependencies: ["CMustache"]),
+        .executableTarget(name: "CMustacheBench", dependencies: ["CMustache"]),
+        .executableTarget(name: "CMustacheCompiler", dependencies: ["CMustache"]),
+        .executableTarget(name: "MustacheGenerator", dependencies: ["CMustache"]),
+        .plugin(name: "MustacheGeneratorPlugin", capability: .buildTool(), dependencies: ["MustacheGenerator"]),
+        .executableTarget(
+            name: "MustacheBench",
+            dependencies: ["Mustache"],
+            plugins: ["MustacheGeneratorPlugin"]
+        ),
+        .target(name: "CMustacheTestSupport", dependencies: ["CMustache"], path: "Tests/CMustacheTestSupport"),
+        .target(name: "CMustacheAllocationSupport", dependencies: ["CMustache"], path: "Tests/CMustacheAllocationSupport"),
+        .testTarget(
+            name: "MustacheTests",
+            dependencies: ["Mustache", "CMustache"],
+            plugins: ["MustacheGeneratorPlugin"]
+        ),
+        .testTarget(name: "CMustacheTests", dependencies: ["CMustacheTestSupport"]),
+        .testTarget(name: "CMustacheAllocationTests", dependencies: ["CMustacheAllocationSupport"]),
+    ]
+)
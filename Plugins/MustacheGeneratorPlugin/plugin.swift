@@ -0,0 +1,26 @@
+import PackagePlugin
+
+/// Generates `MustacheTemplates`, the Swift render functions of the
+/// .mustache files of the target, with MustacheGenerator.
+@main
+struct MustacheGeneratorPlugin: BuildToolPlugin {
+    func createBuildCommands(context: PluginContext, target: Target) throws -> [Command] {
+        guard let target = target as? SourceModuleTarget else {
+            return []
+        }
+        let templates = target.sourceFiles.map { $0.path }.filter { $0.extension == "mustache" }
+        guard !templates.isEmpty else {
+            return []
+        }
+        let output = context.pluginWorkDirectory.appending("MustacheTemplates.swift")
+        return [
+            .buildCommand(
+                displayName: "Generating the render functions of \(target.name) templates",
+                executable: try context.tool(named: "MustacheGenerator").path,
+                arguments: [output.string, target.directory.string] + templates.map { $0.string },
+                inputFiles: templates,
+                outputFiles: [output]
+            ),
+        ]
+    }
+}
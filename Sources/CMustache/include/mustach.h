@@ -0,0 +1,938 @@
+/*
+ Author: José Bollo <jobol@nonadev.net>
+ Author: José Bollo <jose.bollo@iot.bzh>
+
+ https://gitlab.com/jobol/mustach
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef _mustach_h_included_
+#define _mustach_h_included_
+#include <stdio.h>
+
+struct mustach_sbuf; /* see below */
+struct mustach_program; /* see mustach_compile */
+struct mustach_partials; /* see mustach_partials_create */
+struct mustach_render; /* see mustach_render_create */
+struct mustach_archive; /* see mustach_archive_open */
+struct mustach_iov; /* see mustach_exec2_iov */
+struct iovec; /* see <sys/uio.h> */
+
+/**
+ * Current version of mustach and its derivates
+ */
+#define MUSTACH_VERSION 99
+#define MUSTACH_VERSION_MAJOR (MUSTACH_VERSION / 100)
+#define MUSTACH_VERSION_MINOR (MUSTACH_VERSION % 100)
+
+/**
+ * Maximum nested imbrications supported
+ */
+#define MUSTACH_MAX_DEPTH  256
+
+/**
+ * Maximum nested partials inlined by mustach_compile_inline
+ */
+#define MUSTACH_MAX_INLINE_DEPTH 32
+
+/**
+ * Maximum length of tags in mustaches {{...}}
+ */
+#define MUSTACH_MAX_LENGTH 1024
+
+/**
+ * Version of the format of the archives of compiled programs
+ */
+#define MUSTACH_ARCHIVE_VERSION 3
+
+/**
+ * Symbol given to the callbacks of mustach_itf2 for names without symbol
+ */
+#define MUSTACH_NO_SYMBOL 0xffffffffu
+
+/**
+ * mustach_itf - interface for callbacks
+ *
+ * All of this function should return a negative value to stop
+ * the mustache processing. The returned negative value will be
+ * then returned to the caller of mustach as is.
+ *
+ * The functions enter and next should return 0 or 1.
+ *
+ * All other functions should normally return MUSTACH_OK (zero).
+ * If it returns a negative value, it means an error that stop
+ * the process and that is reported to the caller.
+ *
+ * @start: If defined (can be NULL), starts the mustach processing
+ *         of the closure, called at the very beginning before any
+ *         mustach processing occurs.
+ *
+ * @put: If defined (can be NULL), writes the value of 'name'
+ *       to 'file' with 'escape' or not.
+ *       As an extension (see NO_ALLOW_EMPTY_TAG), the 'name' can be
+ *       the empty string. In that later case an implementation can
+ *       return MUSTACH_ERROR_EMPTY_TAG to refuse empty names.
+ *       If NULL and 'get' NULL the error MUSTACH_ERROR_INVALID_ITF
+ *       is returned.
+ *
+ * @enter: Enters the section of 'name' if possible.
+ *         Musts return 1 if entered or 0 if not entered.
+ *         When 1 is returned, the function 'leave' will always be called.
+ *         Conversely 'leave' is never called when enter returns 0 or
+ *         a negative value.
+ *         When 1 is returned, the function must activate the first
+ *         item of the section.
+ *
+ * @next: Activates the next item of the section if it exists.
+ *        Musts return 1 when the next item is activated.
+ *        Musts return 0 when there is no item to activate.
+ *
+ * @leave: Leaves the last entered section
+ *
+ * @partial: If defined (can be NULL), returns in 'sbuf' the content of the
+ *           partial of 'name'. @see mustach_sbuf
+ *           Returns 0 when the content only depends on 'name', 1 when it
+ *           depends on the context and must not be kept by the renderings
+ *           of mustach_exec2* (see mustach_options) or a negative error.
+ *           If NULL but 'get' not NULL, 'get' is used instead of partial.
+ *           If NULL and 'get' NULL and 'put' not NULL, 'put' is called with
+ *           a true FILE.
+ *
+ * @emit: If defined (can be NULL), writes the 'buffer' of 'size' with 'escape'.
+ *        If NULL the standard function 'fwrite' is used with a true FILE.
+ *        If not NULL that function is called instead of 'fwrite' to output
+ *        text.
+ *        It implies that if you define either 'partial' or 'get' callback,
+ *        the meaning of 'FILE *file' is abstract for mustach's process and
+ *        then you can use 'FILE*file' pass any kind of pointer (including NULL)
+ *        to the function 'fmustach'. An example of a such behaviour is given by
+ *        the implementation of 'umustach_json_c'.
+ *
+ * @get: If defined (can be NULL), returns in 'sbuf' the value of 'name'.
+ *       As an extension (see NO_ALLOW_EMPTY_TAG), the 'name' can be
+ *       the empty string. In that later case an implementation can
+ *       return MUSTACH_ERROR_EMPTY_TAG to refuse empty names.
+ *       If NULL and 'put' NULL the error MUSTACH_ERROR_INVALID_ITF
+ *       is returned.
+ *
+ * @stop: If defined (can be NULL), stops the mustach processing
+ *        of the closure, called at the very end after all mustach
+ *        processing occurerd. The status returned by the processing
+ *        is passed to the stop.
+ *
+ * The array below summarize status of callbacks:
+ *
+ *    FULLY OPTIONAL:   start partial
+ *    MANDATORY:        enter next leave
+ *    COMBINATORIAL:    put emit get
+ *
+ * Not definig a MANDATORY callback returns error MUSTACH_ERROR_INVALID_ITF.
+ *
+ * For COMBINATORIAL callbacks the array below summarize possible combinations:
+ *
+ *  combination  : put     : emit    : get     : abstract FILE
+ *  -------------+---------+---------+---------+-----------------------
+ *  HISTORIC     : defined : NULL    : NULL    : NO: standard FILE
+ *  MINIMAL      : NULL    : NULL    : defined : NO: standard FILE
+ *  CUSTOM       : NULL    : defined : defined : YES: abstract FILE
+ *  DUCK         : defined : NULL    : defined : NO: standard FILE
+ *  DANGEROUS    : defined : defined : any     : YES or NO, depends on 'partial'
+ *  INVALID      : NULL    : any     : NULL    : -
+ *
+ * The DUCK case runs on one leg. 'get' is not used if 'partial' is defined
+ * but is used for 'partial' if 'partial' is NULL. Thus for clarity, do not use
+ * it that way but define 'partial' and let 'get' NULL.
+ *
+ * The DANGEROUS case is special: it allows abstract FILE if 'partial' is defined
+ * but forbids abstract FILE when 'partial' is NULL.
+ *
+ * The INVALID case returns error MUSTACH_ERROR_INVALID_ITF.
+ */
+struct mustach_itf {
+    int (*start)(void *closure);
+    int (*put)(void *closure, const char *name, int escape, FILE *file);
+    int (*enter)(void *closure, const char *name);
+    int (*next)(void *closure);
+    int (*leave)(void *closure);
+    int (*partial)(void *closure, const char *name, struct mustach_sbuf *sbuf);
+    int (*emit)(void *closure, const char *buffer, size_t size, int escape, FILE *file);
+    int (*get)(void *closure, const char *name, struct mustach_sbuf *sbuf);
+    void (*stop)(void *closure, int status);
+};
+
+/**
+ * mustach_sbuf - Interface for handling zero terminated strings
+ *
+ * That structure is used for returning zero terminated strings -in 'value'-
+ * to mustach. The callee can provide a function for releasing the returned
+ * 'value'. Three methods for releasing the string are possible.
+ *
+ *  1. no release: set either 'freecb' or 'releasecb' with NULL (done by default)
+ *  2. release without closure: set 'freecb' to its expected value
+ *  3. release with closure: set 'releasecb' and 'closure' to their expected values
+ *
+ * The callee can also set the 'length' of the value. In that case the value
+ * doesn't need to be zero terminated and mustach doesn't call 'strlen'.
+ *
+ * @value: The value of the string. That value is not changed by mustach -const-.
+ *
+ * @freecb: The function to call for freeing the value without closure.
+ *          For convenience, signature of that callback is compatible with 'free'.
+ *          Can be NULL.
+ *
+ * @releasecb: The function to release with closure.
+ *             Can be NULL.
+ *
+ * @closure: The closure to use for 'releasecb'.
+ *
+ * @length: The length in bytes of 'value' or 0 if 'value' is zero terminated.
+ */
+struct mustach_sbuf {
+    const char *value;
+    union {
+        void (*freecb)(void*);
+        void (*releasecb)(const char *value, void *closure);
+    };
+    void *closure;
+    size_t length;
+};
+
+/**
+ * mustach_itf2 - interface for callbacks receiving names with their length
+ *
+ * That interface is the same as mustach_itf except that the names are given
+ * to the callbacks 'put', 'enter', 'partial' and 'get' with their 'length'.
+ * The names point directly in the compiled program and MAY NOT be zero
+ * terminated: the callbacks must only read 'length' bytes.
+ *
+ * Combined with the field 'length' of mustach_sbuf, names and values are
+ * exchanged without any copy nor call to 'strlen'.
+ *
+ * The interface mustach_itf can be used where mustach_itf2 is expected
+ * through the adapter 'mustach_adapter'.
+ *
+ * Compiling a program assigns to each distinct name a symbol, its index in
+ * the table returned by 'mustach_program_symbol'. A provider can resolve
+ * the symbols of the program once for all before rendering it and define
+ * the optional callbacks below to avoid any per-tag lookup of names:
+ *
+ * @enter_by_id: If defined (can be NULL), replaces 'enter' for the 'symbol'.
+ *
+ * @get_by_id: If defined (can be NULL), replaces 'get' for the 'symbol'.
+ *             It is not used when 'put' is defined.
+ *
+ * These callbacks are only used for the names of the rendered program: the
+ * names of partials are always given by name.
+ *
+ * Dotted names like "a.b.c" are split in segments when compiling. When the
+ * optional callbacks below are defined, the engine resolves them segment by
+ * segment so that the provider never has to split names itself. Each
+ * segment is given with its name, its 'length' and its 'symbol', the symbol
+ * being MUSTACH_NO_SYMBOL for the names of partials:
+ *
+ * @get_child: If defined (can be NULL), resolves the segment 'name' and
+ *             makes it the current item of the walk. When 'first' is not
+ *             zero, 'name' is resolved in the context as 'get' would do,
+ *             otherwise it is the child 'name' of the current item. When
+ *             'sbuf' is not NULL, the segment is the last one and 'sbuf'
+ *             receives its value. Must return 1 if found, 0 if not found
+ *             or a negative error code. It is not used when 'put' is
+ *             defined and is used instead of 'get' or 'get_by_id' for
+ *             dotted names.
+ *
+ * @enter_child: If defined (can be NULL), enters the section of the child
+ *               'name' of the current item of the walk as 'enter' would
+ *               do. It is used instead of 'enter' or 'enter_by_id' for
+ *               dotted names and only when 'get_child' is defined.
+ */
+struct mustach_itf2 {
+    int (*start)(void *closure);
+    int (*put)(void *closure, const char *name, size_t length, int escape, FILE *file);
+    int (*enter)(void *closure, const char *name, size_t length);
+    int (*next)(void *closure);
+    int (*leave)(void *closure);
+    int (*partial)(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf);
+    int (*emit)(void *closure, const char *buffer, size_t size, int escape, FILE *file);
+    int (*get)(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf);
+    void (*stop)(void *closure, int status);
+    int (*enter_by_id)(void *closure, unsigned symbol);
+    int (*get_by_id)(void *closure, unsigned symbol, struct mustach_sbuf *sbuf);
+    int (*get_child)(void *closure, int first, const char *name, size_t length, unsigned symbol, struct mustach_sbuf *sbuf);
+    int (*enter_child)(void *closure, const char *name, size_t length, unsigned symbol);
+};
+
+/**
+ * mustach_adapter - adapts a mustach_itf and its closure to mustach_itf2
+ *
+ * After 'mustach_adapt(&adapter, itf, closure)', the interface
+ * '&adapter.itf2' with the closure '&adapter' can be given to the
+ * functions expecting a mustach_itf2. The adapter must remain valid
+ * during the rendering.
+ *
+ * @itf2:    the adapted interface
+ * @itf:     the historic interface
+ * @closure: the closure of the historic interface
+ */
+struct mustach_adapter {
+    struct mustach_itf2 itf2;
+    struct mustach_itf *itf;
+    void *closure;
+};
+
+extern void mustach_adapt(struct mustach_adapter *adapter, struct mustach_itf *itf, void *closure);
+
+/*
+ * Definition of error codes returned by mustach
+ */
+#define MUSTACH_OK                       0
+#define MUSTACH_ERROR_SYSTEM            -1
+#define MUSTACH_ERROR_UNEXPECTED_END    -2
+#define MUSTACH_ERROR_EMPTY_TAG         -3
+#define MUSTACH_ERROR_TAG_TOO_LONG      -4
+#define MUSTACH_ERROR_BAD_SEPARATORS    -5
+#define MUSTACH_ERROR_TOO_DEEP          -6
+#define MUSTACH_ERROR_CLOSING           -7
+#define MUSTACH_ERROR_BAD_UNESCAPE_TAG  -8
+#define MUSTACH_ERROR_INVALID_ITF       -9
+#define MUSTACH_ERROR_ITEM_NOT_FOUND    -10
+#define MUSTACH_ERROR_PARTIAL_NOT_FOUND -11
+#define MUSTACH_ERROR_ABORTED           -12
+#define MUSTACH_ERROR_BAD_ARCHIVE       -13
+#define MUSTACH_ERROR_TOO_SMALL         -14
+
+/* You can use definition below for user specific error */
+#define MUSTACH_ERROR_USER_BASE         -100
+#define MUSTACH_ERROR_USER(x)           (MUSTACH_ERROR_USER_BASE-(x))
+
+/**
+ * fmustach - Renders the mustache 'template' in 'file' for 'itf' and 'closure'.
+ *
+ * @template: the template string to instanciate
+ * @itf:      the interface to the functions that mustach calls
+ * @closure:  the closure to pass to functions called
+ * @file:     the file where to write the result
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int fmustach(const char *template, struct mustach_itf *itf, void *closure, FILE *file);
+
+/**
+ * fmustach - Renders the mustache 'template' in 'fd' for 'itf' and 'closure'.
+ *
+ * The output is written directly in 'fd' through a buffer of 4096 bytes,
+ * the writes are completed after short writes and interruptions. The
+ * file descriptor remains to the caller: it is not closed.
+ *
+ * @template: the template string to instanciate
+ * @itf:      the interface to the functions that mustach calls
+ * @closure:  the closure to pass to functions called
+ * @fd:       the file descriptor number where to write the result
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int fdmustach(const char *template, struct mustach_itf *itf, void *closure, int fd);
+
+/**
+ * fmustach - Renders the mustache 'template' in 'result' for 'itf' and 'closure'.
+ *
+ * The result is written in a memory buffer growing geometrically, it is
+ * zero terminated and must be freed by the caller with free.
+ *
+ * @template: the template string to instanciate
+ * @itf:      the interface to the functions that mustach calls
+ * @closure:  the closure to pass to functions called
+ * @result:   the pointer receiving the result when 0 is returned
+ * @size:     the size of the returned result
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach(const char *template, struct mustach_itf *itf, void *closure, char **result, size_t *size);
+
+/**
+ * mustach_file - Renders the mustache 'template' of 'length' bytes in 'file'
+ * for 'itf' and 'closure'.
+ *
+ * The template doesn't need to be zero terminated: it is only read within
+ * its 'length', it can be a part of a bigger buffer or of a mapped file.
+ * It is compiled in place (see mustach_compile_inplace): its texts are
+ * rendered from where they are, only the tag names are copied.
+ *
+ * @template: the template string to instanciate
+ * @length:   the length in bytes of the template
+ * @itf:      the interface to the functions that mustach calls
+ * @closure:  the closure to pass to functions called
+ * @file:     the file where to write the result
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach_file(const char *template, size_t length, struct mustach_itf *itf, void *closure, FILE *file);
+
+/**
+ * mustach_fd - Renders the mustache 'template' of 'length' bytes in 'fd'
+ * for 'itf' and 'closure'. See mustach_file.
+ *
+ * @template: the template string to instanciate
+ * @length:   the length in bytes of the template
+ * @itf:      the interface to the functions that mustach calls
+ * @closure:  the closure to pass to functions called
+ * @fd:       the file descriptor number where to write the result
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach_fd(const char *template, size_t length, struct mustach_itf *itf, void *closure, int fd);
+
+/**
+ * mustach_mem - Renders the mustache 'template' of 'length' bytes in 'result'
+ * for 'itf' and 'closure'. See mustach_file.
+ *
+ * @template: the template string to instanciate
+ * @length:   the length in bytes of the template
+ * @itf:      the interface to the functions that mustach calls
+ * @closure:  the closure to pass to functions called
+ * @result:   the pointer receiving the result when 0 is returned
+ * @size:     the size of the returned result
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach_mem(const char *template, size_t length, struct mustach_itf *itf, void *closure, char **result, size_t *size);
+
+/**
+ * mustach_compile - Compiles the mustache 'template' of 'length' bytes to a
+ * program that can be rendered many times with 'mustach_exec'.
+ *
+ * Compiling scans the template, trims and records the tag names, resolves
+ * the separators changes and the jumps of sections once for all. The
+ * compiled program doesn't refer to 'template' that can be released.
+ *
+ * The returned program is immutable: it can be shared by concurrent
+ * renderings. It must be released using 'mustach_program_free'.
+ *
+ * @template: the template string to compile
+ * @length:   the length in bytes of the template
+ * @program:  the pointer receiving the program when 0 is returned
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach_compile(const char *template, size_t length, struct mustach_program **program);
+
+/**
+ * mustach_compile_inplace - Compiles the mustache 'template' of 'length'
+ * bytes like 'mustach_compile' but without copying its texts.
+ *
+ * The texts of the program refer to 'template' where they are: only the
+ * tag names and the separators are copied, a big template is compiled in
+ * a program of the size of its tags. The template must remain valid and
+ * unchanged until the program is released, and the program can't be
+ * written in an archive. It suits the templates rendered once.
+ *
+ * @template: the template string to compile, at most 4 GiB
+ * @length:   the length in bytes of the template
+ * @program:  the pointer receiving the program when 0 is returned
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach_compile_inplace(const char *template, size_t length, struct mustach_program **program);
+
+/**
+ * mustach_compile_inline - Compiles the mustache 'template' of 'length'
+ * bytes like 'mustach_compile' but with the partials inlined.
+ *
+ * The text of each partial is asked to 'partial' when compiling and is
+ * compiled in place, with the separators in effect where it is included,
+ * so that rendering the program doesn't fetch nor compile it anymore.
+ * Partials included by themselves, directly or not, and partials nested
+ * deeper than MUSTACH_MAX_INLINE_DEPTH are kept as partials fetched when
+ * rendering. The sections of the inlined partials count in the nesting of
+ * the sections where they are included, limited to MUSTACH_MAX_DEPTH.
+ *
+ * @template: the template string to compile
+ * @length:   the length in bytes of the template
+ * @partial:  the resolver of partials, it receives the 'name' of 'length'
+ *            of the partial and returns 1 with the text of the partial
+ *            in 'sbuf', 0 to keep the partial for the rendering or a
+ *            negative error code
+ * @closure:  the closure to pass to 'partial'
+ * @program:  the pointer receiving the program when 0 is returned
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach_compile_inline(const char *template, size_t length,
+                                  int (*partial)(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf),
+                                  void *closure, struct mustach_program **program);
+
+/**
+ * mustach_exec - Renders the compiled 'program' in 'file' for 'itf' and 'closure'.
+ *
+ * @program:  the program to render, as returned by 'mustach_compile'
+ * @itf:      the interface to the functions that mustach calls
+ * @closure:  the closure to pass to functions called
+ * @file:     the file where to write the result
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach_exec(const struct mustach_program *program, struct mustach_itf *itf, void *closure, FILE *file);
+
+/**
+ * mustach_options - options of the renderings of mustach_exec2*
+ *
+ * Any rendering fetches and compiles once each partial for which the
+ * callback 'partial' returns 0: the partial is kept by name and separators
+ * and is reused for the rest of the rendering without calling 'partial'
+ * again, so its text must only depend on its name. The partials for which
+ * 'partial' returns 1 and the partials given by 'get' or 'put' when
+ * 'partial' is NULL depend on the context: they are fetched and compiled
+ * at each inclusion and are never kept.
+ *
+ * @partials: if not NULL, the cache of partials to use and to fill instead
+ *            of the cache of the rendering. It keeps the partials across
+ *            renderings until invalidated. It must not be used by
+ *            concurrent renderings.
+ *
+ * @max_depth: the maximum nesting of partials, MUSTACH_MAX_DEPTH if 0.
+ *             The partials are executed without recursion: the memory
+ *             used grows with the actual nesting up to that maximum,
+ *             beyond it the rendering fails with MUSTACH_ERROR_TOO_DEEP.
+ *
+ * @capacity: the minimal initial size of the buffer of mustach_exec2_mem,
+ *            see mustach_size_hint. The buffer doubles each time it is
+ *            full.
+ *
+ * @buffer:   the size of the buffer of mustach_exec2_fd, 4096 bytes if 0.
+ *            The buffer is written when full, the writes not fitting in
+ *            it are written at once with the buffered bytes.
+ *
+ * @estimate: if not NULL, the running estimate of the size of the outputs
+ *            of the program, initially 0. mustach_exec2_mem sizes its
+ *            buffer from it and it, mustach_exec2_iov and
+ *            mustach_exec2_write update it after each rendering. It is
+ *            read and written atomically, so it can be shared by the
+ *            concurrent renderings of a program.
+ */
+struct mustach_options {
+    struct mustach_partials *partials;
+    unsigned max_depth;
+    size_t capacity;
+    size_t buffer;
+    size_t *estimate;
+};
+
+/**
+ * mustach_exec2 - Renders the compiled 'program' in 'file' for the
+ * interface 'itf' of version 2 and 'closure'. See mustach_exec.
+ *
+ * @options:  the options of the rendering, can be NULL for the defaults
+ */
+extern int mustach_exec2(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, FILE *file);
+
+/**
+ * mustach_exec2_fd - Renders the compiled 'program' in 'fd' for the
+ * interface 'itf' of version 2 and 'closure'. See fdmustach.
+ */
+extern int mustach_exec2_fd(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, int fd);
+
+/**
+ * mustach_exec2_mem - Renders the compiled 'program' in 'result' for the
+ * interface 'itf' of version 2 and 'closure'. See mustach.
+ */
+extern int mustach_exec2_mem(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, char **result, size_t *size);
+
+/**
+ * mustach_exec2_write - Renders the compiled 'program' through the function
+ * 'write' for the interface 'itf' of version 2 and 'closure'.
+ *
+ * The output is given to 'write' by pieces as it is produced, escaped
+ * as needed, without buffering nor stream. The callbacks 'emit' and
+ * 'put' of 'itf', if any, are still given a stream writing in 'write'.
+ *
+ * @options:  the options of the rendering, can be NULL for the defaults;
+ *            its estimate is updated
+ * @write:    the function receiving the 'size' bytes of 'buffer', it
+ *            returns 0 or a negative error code that stops the rendering
+ * @writer:   the closure to pass to 'write'
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach_exec2_write(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options,
+                               int (*write)(void *writer, const char *buffer, size_t size), void *writer);
+
+/**
+ * mustach_exec2_buffer - Renders the compiled 'program' in the 'buffer' of
+ * 'capacity' bytes for the interface 'itf' of version 2 and 'closure'.
+ *
+ * The rendering allocates no memory when 'itf' doesn't, when it defines
+ * neither 'emit' nor 'put', that are given a stream allocated for the
+ * rendering, when the partials of 'program', if any, are inlined or
+ * already compiled in the cache of 'options', and with at most 7 levels
+ * of partials. The output is zero terminated.
+ *
+ * @options:  the options of the rendering, can be NULL for the defaults
+ * @buffer:   the buffer receiving the output, can be NULL if 'capacity' is 0
+ * @capacity: the size of 'buffer' in bytes
+ * @length:   receives the length of the output when 0 is returned or the
+ *            size of the buffer it needs, with its terminating zero, when
+ *            MUSTACH_ERROR_TOO_SMALL is returned
+ *
+ * Returns 0 in case of success, MUSTACH_ERROR_TOO_SMALL if the output and
+ * its terminating zero don't fit in 'buffer', that then contains its
+ * beginning, -1 with errno set in case of system error or a other negative
+ * value in case of error.
+ */
+extern int mustach_exec2_buffer(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options,
+                                char *buffer, size_t capacity, size_t *length);
+
+/**
+ * mustach_stream - Renders in 'file' the template read by chunks through
+ * 'read' for the interface 'itf' of version 2 and 'closure'.
+ *
+ * The template is compiled and executed as its top level units become
+ * complete: text, tags and whole top level sections. Only the part not
+ * yet complete is kept, so the memory used is bounded by the size of the
+ * largest top level section instead of the size of the template. The
+ * names are not resolved by identifier: 'enter_by_id' and 'get_by_id'
+ * are not called.
+ *
+ * @read:     the function reading at most 'size' bytes of the template in
+ *            'buffer' and returning their count in 'count', 0 at its end.
+ *            It returns 0 in case of success or a negative error code
+ * @reader:   the closure to pass to 'read'
+ * @itf:      the interface to the functions that mustach calls
+ * @closure:  the closure to pass to functions called
+ * @options:  the options of the rendering, can be NULL for the defaults
+ * @file:     the file where to write the result
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach_stream(int (*read)(void *closure, char *buffer, size_t size, size_t *count), void *reader,
+                          struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, FILE *file);
+
+/**
+ * mustach_stream_fd - Renders in 'file' the template read from the file
+ * descriptor 'input' until its end. See mustach_stream.
+ */
+extern int mustach_stream_fd(int input, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, FILE *file);
+
+/**
+ * mustach_render_create - Creates the state of a step-wise rendering of
+ * the compiled 'program' for the interface 'itf' and 'closure'.
+ *
+ * The rendering is then produced by successive calls to 'mustach_step'
+ * that the caller can spread in time, for example when writing to a non
+ * blocking socket. The function 'start' of 'itf' is called at creation
+ * and the function 'stop' when the rendering ends, when 'start' doesn't
+ * return 0 or, with the status MUSTACH_ERROR_ABORTED, when it is released
+ * before its end.
+ *
+ * As for the other renderings, a positive value returned by 'start'
+ * stops the rendering before its beginning: that value is returned and
+ * the rendering is complete, its steps write nothing and return 0.
+ *
+ * @render:   the pointer receiving the rendering when 0 or a positive
+ *            value is returned
+ * @program:  the program to render, it must remain valid until release
+ * @itf:      the interface to the functions that mustach calls
+ * @closure:  the closure to pass to functions called
+ * @options:  the options of the rendering, can be NULL for the defaults
+ *
+ * Returns 0 in case of success, the positive value returned by 'start',
+ * -1 with errno set in case of system error a other negative value in
+ * case of error.
+ */
+extern int mustach_render_create(struct mustach_render **render, const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options);
+
+/**
+ * mustach_step - Continues the 'render' writing at most 'capacity' bytes
+ * of its output in 'buffer'.
+ *
+ * The rendering runs until 'buffer' is full and keeps its position for
+ * the next step. An operation writing more than the remaining capacity
+ * is completed: the bytes in excess are kept and given first by the next
+ * step, so the memory kept by the rendering is bounded by the largest
+ * output of a single tag.
+ *
+ * @render:   the rendering
+ * @buffer:   the buffer receiving the output
+ * @capacity: the capacity of 'buffer', not 0
+ * @written:  receives the count of bytes written in 'buffer'
+ *
+ * Returns 1 if the rendering must be continued, 0 if it is complete, -1
+ * with errno set in case of system error or a other negative value in
+ * case of error. After 0 or an error, the rendering can only be released,
+ * except after MUSTACH_ERROR_TOO_SMALL returned for a 'capacity' of 0
+ * that leaves the rendering unchanged.
+ */
+extern int mustach_step(struct mustach_render *render, char *buffer, size_t capacity, size_t *written);
+
+/**
+ * mustach_render_free - Releases the 'render' created by 'mustach_render_create'.
+ *
+ * @render:   the rendering to release, can be NULL
+ */
+extern void mustach_render_free(struct mustach_render *render);
+
+/**
+ * mustach_exec2_iov - Renders the compiled 'program' as a list of segments
+ * for the interface 'itf' of version 2 and 'closure'.
+ *
+ * The texts of 'program' are not copied: their segments point into the
+ * program, which must remain valid as long as the result is used. The
+ * values, the escapes, the short texts and the texts of the partials are
+ * copied in blocks of memory kept by the result.
+ *
+ * @options:  the options of the rendering, can be NULL for the defaults
+ * @iov:      the pointer receiving the result when 0 is returned, to be
+ *            released with mustach_iov_free
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error
+ * a other negative value in case of error.
+ */
+extern int mustach_exec2_iov(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, struct mustach_iov **iov);
+
+/**
+ * mustach_exec2_writev - Renders the compiled 'program' as a list of
+ * segments, see mustach_exec2_iov, then writes it in 'fd' with writev.
+ * The file descriptor is not closed.
+ */
+extern int mustach_exec2_writev(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, int fd);
+
+/**
+ * mustach_iov_segments - Returns the segments of 'iov' and their count
+ * in 'count'. They are valid until 'iov' is released.
+ */
+extern const struct iovec *mustach_iov_segments(const struct mustach_iov *iov, int *count);
+
+/**
+ * mustach_iov_length - Returns the total length in bytes of the segments of 'iov'.
+ */
+extern size_t mustach_iov_length(const struct mustach_iov *iov);
+
+/**
+ * mustach_iov_write - Writes the segments of 'iov' in 'fd' with writev,
+ * continuing after the short writes and the interruptions.
+ *
+ * Returns 0 in case of success or -1 with errno set.
+ */
+extern int mustach_iov_write(const struct mustach_iov *iov, int fd);
+
+/**
+ * mustach_iov_free - Releases the 'iov' of mustach_exec2_iov.
+ *
+ * @iov:      the result to release, can be NULL
+ */
+extern void mustach_iov_free(struct mustach_iov *iov);
+
+/**
+ * mustach_partials_create - Creates an empty cache of partials to keep the
+ * compiled partials across renderings. See mustach_options.
+ *
+ * @partials: the pointer receiving the cache when 0 is returned
+ *
+ * Returns 0 in case of success or -1 with errno set.
+ */
+extern int mustach_partials_create(struct mustach_partials **partials);
+
+/**
+ * mustach_partials_invalidate - Removes from the cache 'partials' the
+ * partial 'name' of 'length' for any separators or all the partials if
+ * 'name' is NULL. The partials removed are fetched again when used.
+ */
+extern void mustach_partials_invalidate(struct mustach_partials *partials, const char *name, size_t length);
+
+/**
+ * mustach_partials_free - Releases the cache 'partials' and its partials.
+ *
+ * @partials: the cache to release, can be NULL
+ */
+extern void mustach_partials_free(struct mustach_partials *partials);
+
+/**
+ * mustach_program_free - Releases the 'program' returned by 'mustach_compile'.
+ *
+ * @program:  the program to release, can be NULL
+ */
+extern void mustach_program_free(struct mustach_program *program);
+
+/**
+ * mustach_program_size - Returns the size in bytes of the 'program', the
+ * memory it occupies as a single block. The texts of a program compiled
+ * in place are not counted.
+ */
+extern size_t mustach_program_size(const struct mustach_program *program);
+
+/**
+ * mustach_program_symbols - Returns the count of symbols of the 'program'.
+ */
+extern unsigned mustach_program_symbols(const struct mustach_program *program);
+
+/**
+ * mustach_program_texts - Returns the total length in bytes of the texts
+ * of the 'program', the static part of its outputs.
+ */
+extern size_t mustach_program_texts(const struct mustach_program *program);
+
+/**
+ * mustach_size_hint - Returns the expected size of the output of the
+ * 'program' rendered with 'options', the size of the buffer allocated by
+ * mustach_exec2_mem without its terminating zero.
+ *
+ * It is the biggest of the total length of the texts, of the running
+ * estimate of 'options' with an eighth more and of its capacity.
+ *
+ * @program:  the program to render
+ * @options:  the options of the rendering, can be NULL
+ */
+extern size_t mustach_size_hint(const struct mustach_program *program, const struct mustach_options *options);
+
+/**
+ * mustach_opcode - operations of the compiled programs, see mustach_program_op
+ */
+enum mustach_opcode {
+    MUSTACH_OP_TEXT,     /* emits the literal text */
+    MUSTACH_OP_PUT,      /* puts the escaped value of name */
+    MUSTACH_OP_PUT_RAW,  /* puts the unescaped value of name */
+    MUSTACH_OP_SECTION,  /* begins the section of name, jump: index of its end */
+    MUSTACH_OP_INVERTED, /* begins the inverted section of name, jump: index of its end */
+    MUSTACH_OP_END,      /* ends a section, jump: index of its begin */
+    MUSTACH_OP_PARTIAL   /* includes the partial of name */
+};
+
+/**
+ * mustach_program_count - Returns the count of operations of the 'program'.
+ */
+extern unsigned mustach_program_count(const struct mustach_program *program);
+
+/**
+ * mustach_program_op - Returns the opcode of the operation of 'index' in
+ * the 'program' or -1 if the index is out of range.
+ *
+ * Tools like code generators use it to translate programs. The sections
+ * of a program are well nested and the separators are already resolved.
+ *
+ * @program:  the compiled program
+ * @index:    the index, from 0 to mustach_program_count(program) - 1
+ * @text:     if not NULL, receives the literal text or the name
+ * @length:   if not NULL, receives the length of the text or of the name
+ * @jump:     if not NULL, receives the index of the matching operation
+ *            of sections and of their ends, 0 otherwise
+ */
+extern int mustach_program_op(const struct mustach_program *program, unsigned index, const char **text, size_t *length, unsigned *jump);
+
+/**
+ * mustach_program_symbol - Returns the name of the 'symbol' of the 'program'
+ * or NULL if the symbol doesn't exist.
+ *
+ * @program:  the compiled program
+ * @symbol:   the symbol, from 0 to mustach_program_symbols(program) - 1
+ * @length:   if not NULL, receives the length of the name
+ *
+ * The returned name is zero terminated.
+ */
+extern const char *mustach_program_symbol(const struct mustach_program *program, unsigned symbol, size_t *length);
+
+/**
+ * mustach_archive_write - Writes in 'file' an archive of the 'count'
+ * compiled 'programs' of 'names'.
+ *
+ * The archive is a single block without pointers, in the byte order of
+ * the writer, that 'mustach_archive_open' maps and renders in place. Its
+ * format is identified by MUSTACH_ARCHIVE_VERSION.
+ *
+ * @file:     the file where to write the archive
+ * @names:    the zero terminated names of the programs, all distinct
+ * @programs: the programs, as returned by 'mustach_compile'
+ * @count:    the count of programs
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error,
+ * MUSTACH_ERROR_BAD_ARCHIVE if a name is duplicated, if a program was
+ * compiled in place or if the archive would exceed 4 GiB.
+ */
+extern int mustach_archive_write(FILE *file, const char *const *names, const struct mustach_program *const *programs, unsigned count);
+
+/**
+ * mustach_archive_open - Opens the archive written by 'mustach_archive_write'
+ * in the file of 'path'.
+ *
+ * The file is mapped in memory and only its header and entries are
+ * checked: each program is checked the first time it is found, so a
+ * corrupted program can't make a rendering fail and opening an archive
+ * costs mostly the page faults of the programs found and rendered. They
+ * are rendered in place. Without mmap (NO_MMAP_FOR_MUSTACH), the file is
+ * read in memory.
+ *
+ * @archive:  the pointer receiving the archive when 0 is returned
+ * @path:     the path of the file
+ *
+ * Returns 0 in case of success, -1 with errno set in case of system error,
+ * MUSTACH_ERROR_BAD_ARCHIVE if the file isn't an archive of this version.
+ */
+extern int mustach_archive_open(struct mustach_archive **archive, const char *path);
+
+/**
+ * mustach_archive_map - Opens like 'mustach_archive_open' the archive of
+ * 'size' bytes at 'data', aligned on 8 bytes, that must remain valid
+ * until the archive is closed.
+ */
+extern int mustach_archive_map(struct mustach_archive **archive, const void *data, size_t size);
+
+/**
+ * mustach_archive_find - Finds in the 'archive' the program of 'name'.
+ *
+ * The program is checked by its first find, the result is remembered:
+ * the next finds only search its name. It remains valid until the
+ * archive is closed and must not be released. Concurrent finds are safe.
+ *
+ * @archive:  the archive
+ * @name:     the name of the program, not necessarily zero terminated
+ * @length:   the length of the name
+ * @program:  the pointer receiving the program when 0 is returned
+ *
+ * Returns 0 in case of success, MUSTACH_ERROR_ITEM_NOT_FOUND if no
+ * program has that name or MUSTACH_ERROR_BAD_ARCHIVE if it is corrupted.
+ */
+extern int mustach_archive_find(const struct mustach_archive *archive, const char *name, size_t length, const struct mustach_program **program);
+
+/**
+ * mustach_archive_count - Returns the count of programs of the 'archive'.
+ */
+extern unsigned mustach_archive_count(const struct mustach_archive *archive);
+
+/**
+ * mustach_archive_name - Returns the zero terminated name of the program
+ * of 'index' in the 'archive', in the order of the names, or NULL if the
+ * index is out of range.
+ *
+ * @length:   if not NULL, receives the length of the name
+ */
+extern const char *mustach_archive_name(const struct mustach_archive *archive, unsigned index, size_t *length);
+
+/**
+ * mustach_archive_close - Closes the 'archive', its programs can't be
+ * used anymore.
+ *
+ * @archive:  the archive to close, can be NULL
+ */
+extern void mustach_archive_close(struct mustach_archive *archive);
+
+#endif
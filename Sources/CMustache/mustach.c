@@ -21,14 +21,21 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
-#ifdef _WIN32
-#include <malloc.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#if !defined(NO_MMAP_FOR_MUSTACH)
+# include <sys/mman.h>
 #endif
-#ifdef __sun
-# include <alloca.h>
+#if !defined(NO_SIMD_FOR_MUSTACH) && (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+# define MUSTACH_SIMD_X86
+# include <immintrin.h>
 #endif
 
 #include "mustach.h"
@@ -42,99 +49,293 @@
 
 struct iwrap {
     int (*emit)(void *closure, const char *buffer, size_t size, int escape, FILE *file);
-    void *closure; /* closure for: enter, next, leave, emit, get */
-    int (*put)(void *closure, const char *name, int escape, FILE *file);
-    void *closure_put; /* closure for put */
-    int (*enter)(void *closure, const char *name);
+    void *closure; /* closure for: enter, next, leave, emit, put, get */
+    int (*put)(void *closure, const char *name, size_t length, int escape, FILE *file);
+    int (*enter)(void *closure, const char *name, size_t length);
     int (*next)(void *closure);
     int (*leave)(void *closure);
-    int (*get)(void *closure, const char *name, struct mustach_sbuf *sbuf);
-    int (*partial)(void *closure, const char *name, struct mustach_sbuf *sbuf);
+    int (*get)(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf);
+    int (*partial)(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf);
     void *closure_partial; /* closure for partial */
+    int (*enter_by_id)(void *closure, unsigned symbol);
+    int (*get_by_id)(void *closure, unsigned symbol, struct mustach_sbuf *sbuf);
+    int (*get_child)(void *closure, int first, const char *name, size_t length, unsigned symbol, struct mustach_sbuf *sbuf);
+    int (*enter_child)(void *closure, const char *name, size_t length, unsigned symbol);
+    const struct mustach_program *program; /* the program whose symbols are given to *_by_id */
+    struct mustach_partials *partials; /* the compiled partials */
+    int cached; /* whether the partials are kept in 'partials' */
 };
 
-#if !defined(NO_OPEN_MEMSTREAM)
-static FILE *memfile_open(char **buffer, size_t *size)
+/*
+ * Sinks
+ *
+ * The executions write their output in a sink: the file given by the
+ * caller, a memory buffer growing geometrically, a buffered file
+ * descriptor, a function of the caller, the buffers of the steps or a
+ * list of segments. The callbacks 'emit' and 'put' of the interfaces receive a FILE:
+ * for the sinks that are not files, a stream writing in the sink is
+ * opened the first time that it is needed. So the renderings in memory
+ * without these callbacks do no stdio work.
+ */
+struct sink {
+    int (*write)(struct sink *sink, const char *buffer, size_t size);
+    FILE *file;      /* the file of the callbacks, NULL until needed */
+    int owned;       /* if the file was opened for the sink */
+    int error;       /* the first error of the writes through the file or in the descriptor */
+    char *data;      /* the memory buffer */
+    size_t length;   /* its used length */
+    size_t capacity; /* its allocated size */
+    void *closure;   /* closure of the other writers */
+    int fd;          /* the file descriptor of the buffered writes */
+    int (*writer)(void *closure, const char *buffer, size_t size); /* the function of the caller */
+    int (*refer)(struct sink *sink, const char *buffer, size_t size);
+    const struct mustach_program *program; /* the program whose texts are given to refer */
+};
+
+/* initial capacity of the memory sinks without hint */
+#define SINK_CAPACITY 4096
+
+static int sink_file_write(struct sink *sink, const char *buffer, size_t size)
 {
-    return open_memstream(buffer, size);
+    return size == 0 || fwrite(buffer, size, 1, sink->file) == 1 ? MUSTACH_OK : MUSTACH_ERROR_SYSTEM;
 }
-static void memfile_abort(FILE *file, char **buffer, size_t *size)
+
+/* grows the memory of 'sink' so that 'size' more bytes fit */
+static int sink_grow(struct sink *sink, size_t size)
 {
-    fclose(file);
-    free(*buffer);
-    *buffer = NULL;
-    *size = 0;
+    size_t capacity;
+    char *data;
+
+    capacity = sink->capacity ? sink->capacity : SINK_CAPACITY;
+    while (capacity - sink->length < size) {
+        if (capacity > SIZE_MAX / 2) {
+            errno = ENOMEM;
+            return MUSTACH_ERROR_SYSTEM;
+        }
+        capacity *= 2;
+    }
+    data = realloc(sink->data, capacity);
+    if (data == NULL) {
+        errno = ENOMEM;
+        return MUSTACH_ERROR_SYSTEM;
+    }
+    sink->data = data;
+    sink->capacity = capacity;
+    return MUSTACH_OK;
 }
-static int memfile_close(FILE *file, char **buffer, size_t *size)
+
+static int sink_mem_write(struct sink *sink, const char *buffer, size_t size)
 {
-    int rc;
+    if (size > sink->capacity - sink->length && sink_grow(sink, size) < 0)
+        return MUSTACH_ERROR_SYSTEM;
+    if (size) {
+        memcpy(&sink->data[sink->length], buffer, size);
+        sink->length += size;
+    }
+    return MUSTACH_OK;
+}
 
-    /* adds terminating null */
-    rc = fputc(0, file) ? MUSTACH_ERROR_SYSTEM : 0;
-    fclose(file);
-    if (rc == 0)
-        /* removes terminating null of the length */
-        (*size)--;
-    else {
-        free(*buffer);
-        *buffer = NULL;
-        *size = 0;
+/* writes the 'count' 'segments' in 'fd', completing the short writes */
+static int fd_writev(int fd, const struct iovec *segments, int count)
+{
+    ssize_t n;
+    size_t offset;
+    int i;
+
+    i = 0;
+    offset = 0; /* count of bytes of segments[i] already written */
+    while (i < count) {
+        if (offset)
+            n = write(fd, (const char*)segments[i].iov_base + offset, segments[i].iov_len - offset);
+        else
+            n = writev(fd, &segments[i], count - i < IOV_MAX ? count - i : IOV_MAX);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return MUSTACH_ERROR_SYSTEM;
+        }
+        offset += (size_t)n;
+        while (i < count && offset >= segments[i].iov_len)
+            offset -= segments[i++].iov_len;
     }
-    return rc;
+    return MUSTACH_OK;
+}
+
+/*
+ * writes in the file descriptor through the buffer 'data' of 'capacity':
+ * the bytes that don't fit are written at once with the buffered ones.
+ * The buffer is only updated by the successful writes and the first
+ * error is recorded, so that the final flush doesn't send stale bytes.
+ */
+static int sink_fd_write(struct sink *sink, const char *buffer, size_t size)
+{
+    struct iovec segments[2];
+    size_t n;
+    int first, rc;
+
+    if (size <= sink->capacity - sink->length) {
+        memcpy(&sink->data[sink->length], buffer, size);
+        sink->length += size;
+        return MUSTACH_OK;
+    }
+    segments[0].iov_base = sink->data;
+    segments[0].iov_len = sink->length;
+    if (size < sink->capacity) {
+        /* fills the buffer, writes it and keeps the rest */
+        n = sink->capacity - sink->length;
+        memcpy(&sink->data[sink->length], buffer, n);
+        segments[0].iov_len = sink->capacity;
+        rc = fd_writev(sink->fd, segments, 1);
+        if (rc < 0)
+            return sink->error = rc;
+        memcpy(sink->data, &buffer[n], size - n);
+        sink->length = size - n;
+        return MUSTACH_OK;
+    }
+    /* writes the big ones with the buffered bytes in a single call */
+    segments[1].iov_base = (void*)buffer;
+    segments[1].iov_len = size;
+    first = sink->length == 0;
+    rc = fd_writev(sink->fd, &segments[first], 2 - first);
+    if (rc < 0)
+        return sink->error = rc;
+    sink->length = 0;
+    return MUSTACH_OK;
+}
+
+/* writes the buffered bytes, unless a write failed before */
+static int sink_fd_flush(struct sink *sink)
+{
+    struct iovec segment = { .iov_base = sink->data, .iov_len = sink->length };
+
+    if (sink->error < 0)
+        return sink->error;
+    sink->length = 0;
+    return segment.iov_len ? fd_writev(sink->fd, &segment, 1) : MUSTACH_OK;
+}
+
+/* writes in the fixed buffer 'data' of 'capacity', counting the bytes beyond */
+static int sink_buffer_write(struct sink *sink, const char *buffer, size_t size)
+{
+    size_t n;
+
+    n = sink->length < sink->capacity ? sink->capacity - sink->length : 0;
+    if (n > size)
+        n = size;
+    if (n)
+        memcpy(&sink->data[sink->length], buffer, n);
+    sink->length += size;
+    return MUSTACH_OK;
+}
+
+/* gives the bytes to the function of the caller, counting them */
+static int sink_writer_write(struct sink *sink, const char *buffer, size_t size)
+{
+    sink->length += size;
+    return size ? sink->writer(sink->closure, buffer, size) : MUSTACH_OK;
+}
+
+/* initializes 'sink' in memory with at least 'capacity' bytes, the default if 0 */
+static int sink_mem_open(struct sink *sink, size_t capacity)
+{
+    memset(sink, 0, sizeof *sink);
+    sink->write = sink_mem_write;
+    return capacity ? sink_grow(sink, capacity) : MUSTACH_OK;
+}
+
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__ANDROID__)
+static int sink_cookie_write(void *cookie, const char *data, int size)
+{
+    struct sink *sink = cookie;
+    int rc = sink->write(sink, data, (size_t)size);
+    if (rc < 0 && sink->error == 0)
+        sink->error = rc;
+    return rc < 0 ? -1 : size;
+}
+static FILE *sink_cookie_open(struct sink *sink)
+{
+    return funopen(sink, NULL, sink_cookie_write, NULL, NULL);
 }
 #else
-static FILE *memfile_open(char **buffer, size_t *size)
+static ssize_t sink_cookie_write(void *cookie, const char *data, size_t size)
 {
-    /*
-     * We can't provide *buffer and *size as open_memstream does but
-     * at least clear them so the caller won't get bad data.
-     */
-    *buffer = NULL;
-    *size = 0;
+    struct sink *sink = cookie;
+    int rc = sink->write(sink, data, size);
+    if (rc < 0 && sink->error == 0)
+        sink->error = rc;
+    return rc < 0 ? -1 : (ssize_t)size;
+}
+static FILE *sink_cookie_open(struct sink *sink)
+{
+    cookie_io_functions_t functions = { .write = sink_cookie_write };
+    return fopencookie(sink, "w", functions);
+}
+#endif
 
-    return tmpfile();
+/* returns the file of the callbacks writing in 'sink', opened if needed, or NULL */
+static FILE *sink_file(struct sink *sink)
+{
+    if (sink->file == NULL) {
+        sink->file = sink_cookie_open(sink);
+        if (sink->file == NULL)
+            return NULL;
+        /* not buffered, to keep the order with the direct writes */
+        setvbuf(sink->file, NULL, _IONBF, 0);
+        sink->owned = 1;
+    }
+    return sink->file;
 }
-static void memfile_abort(FILE *file, char **buffer, size_t *size)
+
+/*
+ * returns the status of a callback of status 'rc' that wrote in the file
+ * of 'sink': the streams don't always report the failures of the writes
+ */
+static int sink_status(struct sink *sink, int rc)
 {
-    fclose(file);
-    *buffer = NULL;
-    *size = 0;
+    return rc >= 0 && sink->error < 0 ? sink->error : rc;
 }
-static int memfile_close(FILE *file, char **buffer, size_t *size)
+
+static void sink_close(struct sink *sink)
 {
-    int rc;
-    size_t s;
-    char *b;
+    if (sink->owned) {
+        fclose(sink->file);
+        sink->file = NULL;
+        sink->owned = 0;
+    }
+}
 
-    s = (size_t)ftell(file);
-    b = malloc(s + 1);
-    if (b == NULL) {
-        rc = MUSTACH_ERROR_SYSTEM;
-        errno = ENOMEM;
-        s = 0;
-    } else {
-        rewind(file);
-        if (1 == fread(b, s, 1, file)) {
-            rc = 0;
-            b[s] = 0;
-        } else {
-            rc = MUSTACH_ERROR_SYSTEM;
-            free(b);
-            b = NULL;
-            s = 0;
-        }
+/*
+ * closes the memory 'sink' of the rendering of status 'rc': gives its data
+ * zero terminated in 'result' and its length in 'size', or frees it when
+ * the rendering failed
+ */
+static int sink_mem_close(struct sink *sink, int rc, char **result, size_t *size)
+{
+    sink_close(sink);
+    if (rc >= 0)
+        rc = sink_mem_write(sink, "", 1);
+    if (rc < 0) {
+        free(sink->data);
+        *result = NULL;
+        *size = 0;
+        return rc;
     }
-    *buffer = b;
-    *size = s;
-    return rc;
+    *result = sink->data;
+    *size = sink->length - 1;
+    return MUSTACH_OK;
 }
-#endif
 
 static inline void sbuf_reset(struct mustach_sbuf *sbuf)
 {
     sbuf->value = NULL;
     sbuf->freecb = NULL;
     sbuf->closure = NULL;
+    sbuf->length = 0;
+}
+
+static inline size_t sbuf_length(struct mustach_sbuf *sbuf)
+{
+    return sbuf->length ? sbuf->length : sbuf->value ? strlen(sbuf->value) : 0;
 }
 
 static inline void sbuf_release(struct mustach_sbuf *sbuf)
@@ -143,138 +344,646 @@ static inline void sbuf_release(struct mustach_sbuf *sbuf)
         sbuf->releasecb(sbuf->value, sbuf->closure);
 }
 
-static int iwrap_emit(void *closure, const char *buffer, size_t size, int escape, FILE *file)
+/* emits in 'sink' the 'buffer' of 'size' bytes, escaped if 'escape' is set */
+static int iwrap_emit(struct iwrap *iwrap, struct sink *sink, const char *buffer, size_t size, int escape)
 {
     size_t i, j;
+    int rc;
+    FILE *file;
 
-    (void)closure; /* unused */
+    if (iwrap->emit) {
+        file = sink_file(sink);
+        return file == NULL ? MUSTACH_ERROR_SYSTEM : sink_status(sink, iwrap->emit(iwrap->closure, buffer, size, escape, file));
+    }
 
     if (!escape)
-        return fwrite(buffer, size, 1, file) != 1 ? MUSTACH_ERROR_SYSTEM : MUSTACH_OK;
+        return sink->write(sink, buffer, size);
 
     i = 0;
     while (i < size) {
         j = i;
         while (j < size && buffer[j] != '<' && buffer[j] != '>' && buffer[j] != '&')
             j++;
-        if (j != i && fwrite(&buffer[i], j - i, 1, file) != 1)
-            return MUSTACH_ERROR_SYSTEM;
+        if (j != i && (rc = sink->write(sink, &buffer[i], j - i)) < 0)
+            return rc;
         if (j < size) {
             switch(buffer[j++]) {
             case '<':
-                if (fwrite("&lt;", 4, 1, file) != 1)
-                    return MUSTACH_ERROR_SYSTEM;
+                rc = sink->write(sink, "&lt;", 4);
                 break;
             case '>':
-                if (fwrite("&gt;", 4, 1, file) != 1)
-                    return MUSTACH_ERROR_SYSTEM;
+                rc = sink->write(sink, "&gt;", 4);
                 break;
             case '&':
-                if (fwrite("&amp;", 5, 1, file) != 1)
-                    return MUSTACH_ERROR_SYSTEM;
+                rc = sink->write(sink, "&amp;", 5);
+                break;
+            default:
+                rc = MUSTACH_OK;
                 break;
-            default: break;
             }
+            if (rc < 0)
+                return rc;
         }
         i = j;
     }
     return MUSTACH_OK;
 }
 
-static int iwrap_put(void *closure, const char *name, int escape, FILE *file)
+static int iwrap_put(struct iwrap *iwrap, struct sink *sink, const char *name, size_t length, int escape)
+{
+    int rc;
+    FILE *file;
+    struct mustach_sbuf sbuf;
+
+    if (iwrap->put) {
+        file = sink_file(sink);
+        return file == NULL ? MUSTACH_ERROR_SYSTEM : sink_status(sink, iwrap->put(iwrap->closure, name, length, escape, file));
+    }
+
+    sbuf_reset(&sbuf);
+    rc = iwrap->get(iwrap->closure, name, length, &sbuf);
+    if (rc >= 0) {
+        length = sbuf_length(&sbuf);
+        if (length)
+            rc = iwrap_emit(iwrap, sink, sbuf.value, length, escape);
+        sbuf_release(&sbuf);
+    }
+    return rc;
+}
+
+static int iwrap_put_by_id(struct iwrap *iwrap, unsigned symbol, int escape, struct sink *sink)
 {
-    struct iwrap *iwrap = closure;
     int rc;
     struct mustach_sbuf sbuf;
     size_t length;
 
     sbuf_reset(&sbuf);
-    rc = iwrap->get(iwrap->closure, name, &sbuf);
+    rc = iwrap->get_by_id(iwrap->closure, symbol, &sbuf);
     if (rc >= 0) {
-        length = strlen(sbuf.value);
+        length = sbuf_length(&sbuf);
         if (length)
-            rc = iwrap->emit(iwrap->closure, sbuf.value, length, escape, file);
+            rc = iwrap_emit(iwrap, sink, sbuf.value, length, escape);
         sbuf_release(&sbuf);
     }
     return rc;
 }
 
-static int iwrap_partial(void *closure, const char *name, struct mustach_sbuf *sbuf)
+static int iwrap_partial(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
 {
     struct iwrap *iwrap = closure;
-    int rc;
-    FILE *file;
+    struct sink sink;
     size_t size;
     char *result;
+    int rc;
 
-    result = NULL;
-    file = memfile_open(&result, &size);
-    if (file == NULL)
-        rc = MUSTACH_ERROR_SYSTEM;
-    else {
-        rc = iwrap->put(iwrap->closure_put, name, 0, file);
+    rc = sink_mem_open(&sink, 0);
+    if (rc == MUSTACH_OK)
+        rc = iwrap_put(iwrap, &sink, name, length, 0);
+    rc = sink_mem_close(&sink, rc, &result, &size);
+    if (rc == MUSTACH_OK) {
+        sbuf->value = result;
+        sbuf->freecb = free;
+        sbuf->length = size;
+    }
+    return rc;
+}
+
+/*
+ * Scanning of separators
+ *
+ * The scanners search the first occurrence of 'delim' of 'dlen' bytes
+ * (dlen > 0) in the text from 'text' to 'end'. The vectorized versions
+ * test in one step 16 or 32 candidate positions for the first and the
+ * last byte of the separator, then check the middle bytes of matching
+ * positions. The best version for the running CPU is selected at the
+ * first call and then read atomically.
+ */
+static const char *scan_scalar(const char *text, const char *end, const char *delim, size_t dlen)
+{
+    const char *p;
+
+    while ((size_t)(end - text) >= dlen) {
+        p = memchr(text, delim[0], (size_t)(end - text) - dlen + 1);
+        if (p == NULL)
+            break;
+        if (!memcmp(p + 1, delim + 1, dlen - 1))
+            return p;
+        text = p + 1;
+    }
+    return NULL;
+}
+
+#if defined(MUSTACH_SIMD_X86)
+__attribute__((target("sse2")))
+static const char *scan_sse2(const char *text, const char *end, const char *delim, size_t dlen)
+{
+    __m128i first, last, a, b;
+    unsigned mask;
+    int i;
+
+    first = _mm_set1_epi8(delim[0]);
+    last = _mm_set1_epi8(delim[dlen - 1]);
+    while ((size_t)(end - text) >= dlen - 1 + 16) {
+        a = _mm_loadu_si128((const __m128i*)text);
+        b = _mm_loadu_si128((const __m128i*)(text + dlen - 1));
+        mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask) {
+            i = __builtin_ctz(mask);
+            if (dlen <= 2 || !memcmp(text + i + 1, delim + 1, dlen - 2))
+                return text + i;
+            mask &= mask - 1;
+        }
+        text += 16;
+    }
+    return scan_scalar(text, end, delim, dlen);
+}
+
+__attribute__((target("avx2")))
+static const char *scan_avx2(const char *text, const char *end, const char *delim, size_t dlen)
+{
+    __m256i first, last, a, b;
+    unsigned mask;
+    int i;
+
+    first = _mm256_set1_epi8(delim[0]);
+    last = _mm256_set1_epi8(delim[dlen - 1]);
+    while ((size_t)(end - text) >= dlen - 1 + 32) {
+        a = _mm256_loadu_si256((const __m256i*)text);
+        b = _mm256_loadu_si256((const __m256i*)(text + dlen - 1));
+        mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last)));
+        while (mask) {
+            i = __builtin_ctz(mask);
+            if (dlen <= 2 || !memcmp(text + i + 1, delim + 1, dlen - 2))
+                return text + i;
+            mask &= mask - 1;
+        }
+        text += 32;
+    }
+    return scan_sse2(text, end, delim, dlen);
+}
+
+typedef const char *(*scanner)(const char *text, const char *end, const char *delim, size_t dlen);
+
+/* the scanner selected for the CPU, NULL until the first scan */
+static scanner scan_selected;
+
+static scanner scan_select(void)
+{
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return scan_avx2;
+    if (__builtin_cpu_supports("sse2"))
+        return scan_sse2;
+    return scan_scalar;
+}
+
+/* concurrent first scans may all select, they store the same scanner atomically */
+static inline const char *scan(const char *text, const char *end, const char *delim, size_t dlen)
+{
+    scanner selected = __atomic_load_n(&scan_selected, __ATOMIC_RELAXED);
+
+    if (selected == NULL) {
+        selected = scan_select();
+        __atomic_store_n(&scan_selected, selected, __ATOMIC_RELAXED);
+    }
+    return selected(text, end, delim, dlen);
+}
+#else
+# define scan scan_scalar
+#endif
+
+/*
+ * Compiled templates
+ *
+ * A program is a single block of memory made of a header, a pool of
+ * strings and an array of operations (see enum mustach_opcode). Operations
+ * refer to the strings of the pool by offset so that a program never
+ * contains any pointer. The jump of MUSTACH_OP_PARTIAL is the offset of
+ * its separators "opstr\0clstr\0".
+ *
+ * The programs compiled in place (see mustach_compile_inplace) are the
+ * exception: the texts stay in the template, their offsets are relative
+ * to it and the program ends with a pointer to the template.
+ */
+struct mustach_op {
+    uint32_t code;   /* the opcode */
+    uint32_t offset; /* offset of the text or of the name in the program */
+    uint32_t length; /* length of the text or of the name */
+    uint32_t jump;   /* see enum mustach_opcode */
+    uint32_t symbol; /* symbol of the name */
+};
+
+/*
+ * distinct names of the program, their index is their symbol
+ * dotted names like "a.b.c" record the symbols of their segments
+ */
+struct mustach_symbol {
+    uint32_t offset; /* offset of the name in the program */
+    uint32_t length; /* length of the name */
+    uint32_t path;   /* index of the first segment in the segments */
+    uint32_t count;  /* count of segments, 0 if the name is not dotted */
+};
+
+struct mustach_program {
+    uint32_t size;     /* size in bytes of the program */
+    uint32_t count;    /* count of operations */
+    uint32_t ops;      /* offset of the operations */
+    uint32_t nsymbols; /* count of symbols */
+    uint32_t symbols;  /* offset of the symbols */
+    uint32_t segments; /* offset of the segments, symbols of the dotted names */
+    uint32_t texts;    /* total length of the texts, at most UINT32_MAX */
+    uint32_t text;     /* offset of the pointer to the template of the texts, 0 if in the pool */
+};
+
+/* the program is built in place in 'pool', starting with room for the header */
+struct compiler {
+    struct mustach_op *ops;
+    size_t count, acount;
+    char *pool;
+    size_t size, asize;
+    struct mustach_symbol *symbols;
+    size_t nsymbols, asymbols;
+    uint32_t *hash; /* open addressing table of symbol + 1, 0 when free */
+    size_t hsize;
+    uint32_t *segments;
+    size_t nsegments, asegments;
+    int (*partial)(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf);
+    void *closure; /* closure of partial, the resolver of inlined partials */
+    const char *base;    /* if set, the template whose texts are not copied */
+    int stream;          /* if set, the template can continue after its end */
+    const char *cut;     /* end of the last complete top level unit */
+    size_t cutcount;     /* count of operations at 'cut' */
+    size_t cutdelims;    /* offset of the separators at 'cut' */
+    size_t depth;        /* count of open sections, the ones of the inlined partials included */
+};
+
+/* returned by compiler_parse in stream mode when the template is incomplete */
+#define COMPILER_MORE 1
+
+/* the partials being inlined, to detect the recursive ones */
+struct inclusion {
+    const struct inclusion *parent;
+    const char *name;
+    size_t length;
+    int depth;
+};
+
+static inline const char *program_string(const struct mustach_program *program, uint32_t offset)
+{
+    return (const char*)program + offset;
+}
+
+/* the text of the operation MUSTACH_OP_TEXT 'op', in the pool or in the template */
+static inline const char *program_text(const struct mustach_program *program, const struct mustach_op *op)
+{
+    if (program->text)
+        return *(const char *const*)((const char*)program + program->text) + op->offset;
+    return program_string(program, op->offset);
+}
+
+static inline const struct mustach_op *program_ops(const struct mustach_program *program)
+{
+    return (const struct mustach_op*)((const char*)program + program->ops);
+}
+
+static inline const struct mustach_symbol *program_symbols(const struct mustach_program *program)
+{
+    return (const struct mustach_symbol*)((const char*)program + program->symbols);
+}
+
+static inline const uint32_t *program_segments(const struct mustach_program *program)
+{
+    return (const uint32_t*)((const char*)program + program->segments);
+}
+
+static int compiler_op(struct compiler *comp, enum mustach_opcode code, size_t offset, size_t length, size_t jump, size_t symbol)
+{
+    struct mustach_op *ops;
+    size_t acount;
+
+    if (comp->count == comp->acount) {
+        acount = comp->acount ? 2 * comp->acount : 16;
+        ops = realloc(comp->ops, acount * sizeof *ops);
+        if (ops == NULL)
+            return MUSTACH_ERROR_SYSTEM;
+        comp->ops = ops;
+        comp->acount = acount;
+    }
+    ops = &comp->ops[comp->count++];
+    ops->code = (uint32_t)code;
+    ops->offset = (uint32_t)offset;
+    ops->length = (uint32_t)length;
+    ops->jump = (uint32_t)jump;
+    ops->symbol = (uint32_t)symbol;
+    return MUSTACH_OK;
+}
+
+/* ensures that the pool can receive 'length' more bytes */
+static int compiler_reserve(struct compiler *comp, size_t length)
+{
+    char *pool;
+    size_t need, asize;
+
+    need = comp->size + length;
+    if (need > UINT32_MAX) {
+        errno = E2BIG;
+        return MUSTACH_ERROR_SYSTEM;
+    }
+    if (need > comp->asize) {
+        asize = comp->asize ? comp->asize : 256;
+        while (asize < need)
+            asize *= 2;
+        pool = realloc(comp->pool, asize);
+        if (pool == NULL)
+            return MUSTACH_ERROR_SYSTEM;
+        comp->pool = pool;
+        comp->asize = asize;
+    }
+    return MUSTACH_OK;
+}
+
+/* adds to the pool the string of 'length', zero terminated if 'zero', returns its offset */
+static int compiler_string(struct compiler *comp, const char *string, size_t length, int zero, size_t *offset)
+{
+    int rc;
+
+    rc = compiler_reserve(comp, length + !!zero);
+    if (rc == MUSTACH_OK) {
+        *offset = comp->size;
+        memcpy(&comp->pool[comp->size], string, length);
+        comp->size += length;
+        if (zero)
+            comp->pool[comp->size++] = 0;
+    }
+    return rc;
+}
+
+/* adds the operation of the 'text' of 'length', copied in the pool unless compiling in place */
+static int compiler_text(struct compiler *comp, const char *text, size_t length)
+{
+    size_t offset;
+    int rc;
+
+    if (comp->base == NULL) {
+        rc = compiler_string(comp, text, length, 0, &offset);
+        if (rc != MUSTACH_OK)
+            return rc;
+    } else
+        offset = (size_t)(text - comp->base);
+    return compiler_op(comp, MUSTACH_OP_TEXT, offset, length, 0, 0);
+}
+
+static uint32_t hash_name(const char *name, size_t length)
+{
+    uint32_t h = 2166136261u; /* FNV-1a */
+
+    while (length--)
+        h = (h ^ (unsigned char)*name++) * 16777619u;
+    return h;
+}
+
+static int compiler_name(struct compiler *comp, const char *name, size_t length, size_t *offset, size_t *symbol);
+
+/* records the segments of the 'symbol' of 'name' if dotted with no empty segment */
+static int compiler_path(struct compiler *comp, size_t symbol, const char *name, size_t length)
+{
+    uint32_t *segments;
+    const char *dot;
+    size_t count, l, i, offset, seg;
+    int rc;
+
+    for (count = 1, l = 0 ; l < length ; l++)
+        if (name[l] == '.') {
+            if (l == 0 || l == length - 1 || name[l - 1] == '.')
+                return MUSTACH_OK;
+            count++;
+        }
+    if (count == 1)
+        return MUSTACH_OK;
+
+    if (comp->nsegments + count > comp->asegments) {
+        l = comp->asegments ? 2 * comp->asegments : 16;
+        while (l < comp->nsegments + count)
+            l *= 2;
+        segments = realloc(comp->segments, l * sizeof *segments);
+        if (segments == NULL)
+            return MUSTACH_ERROR_SYSTEM;
+        comp->segments = segments;
+        comp->asegments = l;
+    }
+    seg = comp->nsegments;
+    comp->nsegments += count;
+    comp->symbols[symbol].path = (uint32_t)seg;
+    comp->symbols[symbol].count = (uint32_t)count;
+    for (i = 0 ; i < count ; i++) {
+        dot = memchr(name, '.', length);
+        l = dot ? (size_t)(dot - name) : length;
+        rc = compiler_name(comp, name, l, &offset, &symbol);
         if (rc < 0)
-            memfile_abort(file, &result, &size);
-        else {
-            rc = memfile_close(file, &result, &size);
-            if (rc == 0) {
-                sbuf->value = result;
-                sbuf->freecb = free;
-            }
+            return rc;
+        comp->segments[seg + i] = (uint32_t)symbol;
+        name += l + 1;
+        length -= l + 1;
+    }
+    return MUSTACH_OK;
+}
+
+/* interns the name of 'length', returns the offset of its string and its symbol */
+static int compiler_name(struct compiler *comp, const char *name, size_t length, size_t *offset, size_t *symbol)
+{
+    struct mustach_symbol *symbols;
+    uint32_t *hash, *slot;
+    size_t i, hsize, mask;
+    int rc;
+
+    /* grows the table to keep it half empty */
+    if (2 * (comp->nsymbols + 1) > comp->hsize) {
+        hsize = comp->hsize ? 2 * comp->hsize : 32;
+        hash = calloc(hsize, sizeof *hash);
+        if (hash == NULL)
+            return MUSTACH_ERROR_SYSTEM;
+        mask = hsize - 1;
+        for (i = 0 ; i < comp->nsymbols ; i++) {
+            slot = &hash[hash_name(&comp->pool[comp->symbols[i].offset], comp->symbols[i].length) & mask];
+            while (*slot)
+                slot = slot == &hash[mask] ? hash : slot + 1;
+            *slot = (uint32_t)(i + 1);
+        }
+        free(comp->hash);
+        comp->hash = hash;
+        comp->hsize = hsize;
+    }
+
+    /* search */
+    mask = comp->hsize - 1;
+    slot = &comp->hash[hash_name(name, length) & mask];
+    while (*slot) {
+        i = *slot - 1;
+        if (comp->symbols[i].length == length && !memcmp(&comp->pool[comp->symbols[i].offset], name, length)) {
+            *offset = comp->symbols[i].offset;
+            *symbol = i;
+            return MUSTACH_OK;
         }
+        slot = slot == &comp->hash[mask] ? comp->hash : slot + 1;
+    }
+
+    /* adds a new symbol */
+    if (comp->nsymbols == comp->asymbols) {
+        i = comp->asymbols ? 2 * comp->asymbols : 16;
+        symbols = realloc(comp->symbols, i * sizeof *symbols);
+        if (symbols == NULL)
+            return MUSTACH_ERROR_SYSTEM;
+        comp->symbols = symbols;
+        comp->asymbols = i;
+    }
+    rc = compiler_string(comp, name, length, 1, offset);
+    if (rc == MUSTACH_OK) {
+        *symbol = comp->nsymbols++;
+        comp->symbols[*symbol].offset = (uint32_t)*offset;
+        comp->symbols[*symbol].length = (uint32_t)length;
+        comp->symbols[*symbol].path = 0;
+        comp->symbols[*symbol].count = 0;
+        *slot = (uint32_t)comp->nsymbols;
+        rc = compiler_path(comp, *symbol, name, length);
     }
     return rc;
 }
 
-static int process(const char *template, struct iwrap *iwrap, FILE *file, const char *opstr, const char *clstr)
+/* appends the operations, the symbols and the segments to the pool and fills the header */
+static int compiler_link(struct compiler *comp, struct mustach_program **program)
 {
-    struct mustach_sbuf sbuf;
-    char name[MUSTACH_MAX_LENGTH + 1], c, *tmp;
-    const char *beg, *term;
-    struct { const char *name, *again; size_t length; int enabled, entered; } stack[MUSTACH_MAX_DEPTH];
-    size_t oplen, cllen, len, l;
-    int depth, rc, enabled;
+    struct mustach_program *prog;
+    size_t base, length, lsymbols, lsegments, text, end, i;
+    uint64_t texts;
+    int rc;
 
-    enabled = 1;
-    oplen = strlen(opstr);
-    cllen = strlen(clstr);
+    base = (comp->size + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    length = comp->count * sizeof *comp->ops;
+    lsymbols = comp->nsymbols * sizeof *comp->symbols;
+    lsegments = comp->nsegments * sizeof *comp->segments;
+    end = base + length + lsymbols + lsegments;
+    text = comp->base == NULL ? 0 : (end + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    if (text)
+        end = text + sizeof comp->base;
+    rc = compiler_reserve(comp, end - comp->size);
+    if (rc < 0)
+        return rc;
+    memset(&comp->pool[comp->size], 0, end - comp->size);
+    if (length)
+        memcpy(&comp->pool[base], comp->ops, length);
+    if (lsymbols)
+        memcpy(&comp->pool[base + length], comp->symbols, lsymbols);
+    if (lsegments)
+        memcpy(&comp->pool[base + length + lsymbols], comp->segments, lsegments);
+    if (text)
+        memcpy(&comp->pool[text], &comp->base, sizeof comp->base);
+    prog = (struct mustach_program*)comp->pool;
+    prog->size = (uint32_t)end;
+    prog->count = (uint32_t)comp->count;
+    prog->ops = (uint32_t)base;
+    prog->nsymbols = (uint32_t)comp->nsymbols;
+    prog->symbols = (uint32_t)(base + length);
+    prog->segments = (uint32_t)(base + length + lsymbols);
+    for (texts = i = 0 ; i < comp->count ; i++)
+        if (comp->ops[i].code == MUSTACH_OP_TEXT)
+            texts += comp->ops[i].length;
+    prog->texts = texts < UINT32_MAX ? (uint32_t)texts : UINT32_MAX;
+    prog->text = (uint32_t)text;
+    *program = prog;
+    comp->pool = NULL;
+    return MUSTACH_OK;
+}
+
+static int compiler_partial(struct compiler *comp, const char *name, size_t length, size_t delims, const struct inclusion *chain);
+
+/* records in stream mode the end of a complete top level unit */
+static inline void compiler_cut(struct compiler *comp, int depth, const char *position, size_t delims)
+{
+    if (depth == 0) {
+        comp->cut = position;
+        comp->cutcount = comp->count;
+        comp->cutdelims = delims;
+    }
+}
+
+/* adds the operations of the 'template' of 'length' for the separators at offset 'delims' */
+static int compiler_parse(struct compiler *comp, const char *template, size_t length, size_t delims, const struct inclusion *chain)
+{
+    const char *end, *beg, *term, *opstr, *clstr;
+    size_t oplen, cllen, len, l, offset, symbol;
+    size_t open; /* 1 + index of the innermost open section, 0 if none */
+    int depth, rc;
+    char c;
+
+    end = template + length;
     depth = 0;
-    for(;;) {
-        beg = strstr(template, opstr);
+    open = 0;
+    rc = MUSTACH_OK;
+    oplen = strlen(&comp->pool[delims]);
+    cllen = strlen(&comp->pool[delims + oplen + 1]);
+    while (rc == MUSTACH_OK) {
+        /* the pool moves when it grows */
+        opstr = &comp->pool[delims];
+        clstr = &opstr[oplen + 1];
+        beg = scan(template, end, opstr, oplen);
+        if (beg == NULL && comp->stream) {
+            /* no more mustach yet, the end could start a tag */
+            l = (size_t)(end - template) < oplen ? 0 : (size_t)(end - template) - oplen + 1;
+            if (l) {
+                rc = compiler_text(comp, template, l);
+                template += l;
+            }
+            if (rc == MUSTACH_OK) {
+                compiler_cut(comp, depth, template, delims);
+                rc = COMPILER_MORE;
+            }
+            break;
+        }
         if (beg == NULL) {
             /* no more mustach */
-            if (enabled && template[0]) {
-                rc = iwrap->emit(iwrap->closure, template, strlen(template), 0, file);
-                if (rc < 0)
-                    return rc;
-            }
-            return depth ? MUSTACH_ERROR_UNEXPECTED_END : MUSTACH_OK;
+            if (template != end)
+                rc = compiler_text(comp, template, (size_t)(end - template));
+            if (rc == MUSTACH_OK && depth)
+                rc = MUSTACH_ERROR_UNEXPECTED_END;
+            break;
         }
-        if (enabled && beg != template) {
-            rc = iwrap->emit(iwrap->closure, template, (size_t)(beg - template), 0, file);
+        if (beg != template) {
+            rc = compiler_text(comp, template, (size_t)(beg - template));
             if (rc < 0)
-                return rc;
+                break;
+            clstr = &comp->pool[delims + oplen + 1];
+            compiler_cut(comp, depth, beg, delims);
         }
         beg += oplen;
-        term = strstr(beg, clstr);
-        if (term == NULL)
-            return MUSTACH_ERROR_UNEXPECTED_END;
+        term = scan(beg, end, clstr, cllen);
+        if (term == NULL) {
+            rc = comp->stream ? COMPILER_MORE : MUSTACH_ERROR_UNEXPECTED_END;
+            break;
+        }
         template = term + cllen;
         len = (size_t)(term - beg);
-        c = *beg;
+        c = len ? *beg : 0;
         switch(c) {
         case '!':
         case '=':
             break;
         case '{':
-            for (l = 0 ; clstr[l] == '}' ; l++);
-            if (clstr[l]) {
-                if (!len || beg[len-1] != '}')
-                    return MUSTACH_ERROR_BAD_UNESCAPE_TAG;
+            for (l = 0 ; l < cllen && clstr[l] == '}' ; l++);
+            if (l < cllen) {
+                if (len < 2 || beg[len-1] != '}') {
+                    rc = MUSTACH_ERROR_BAD_UNESCAPE_TAG;
+                    break;
+                }
                 len--;
             } else {
-                if (term[l] != '}')
-                    return MUSTACH_ERROR_BAD_UNESCAPE_TAG;
+                if (term + l >= end && comp->stream) {
+                    rc = COMPILER_MORE;
+                    break;
+                }
+                if (term + l >= end || term[l] != '}') {
+                    rc = MUSTACH_ERROR_BAD_UNESCAPE_TAG;
+                    break;
+                }
                 template++;
             }
             c = '&';
@@ -288,19 +997,20 @@ static int process(const char *template, struct iwrap *iwrap, FILE *file, const
         case ':':
 #endif
             beg++; len--;
+            /*@fallthrough@*/
         default:
             while (len && isspace(beg[0])) { beg++; len--; }
             while (len && isspace(beg[len-1])) len--;
 #if !defined(NO_ALLOW_EMPTY_TAG)
             if (len == 0)
-                return MUSTACH_ERROR_EMPTY_TAG;
+                rc = MUSTACH_ERROR_EMPTY_TAG;
 #endif
             if (len > MUSTACH_MAX_LENGTH)
-                return MUSTACH_ERROR_TAG_TOO_LONG;
-            memcpy(name, beg, len);
-            name[len] = 0;
+                rc = MUSTACH_ERROR_TAG_TOO_LONG;
             break;
         }
+        if (rc != MUSTACH_OK)
+            break;
         switch(c) {
         case '!':
             /* comment */
@@ -308,165 +1018,1775 @@ static int process(const char *template, struct iwrap *iwrap, FILE *file, const
             break;
         case '=':
             /* defines separators */
-            if (len < 5 || beg[len - 1] != '=')
-                return MUSTACH_ERROR_BAD_SEPARATORS;
+            if (len < 5 || beg[len - 1] != '=') {
+                rc = MUSTACH_ERROR_BAD_SEPARATORS;
+                break;
+            }
             beg++;
             len -= 2;
+            while (len && isspace(beg[0])) { beg++; len--; }
+            while (len && isspace(beg[len-1])) len--;
             for (l = 0; l < len && !isspace(beg[l]) ; l++);
-            if (l == len)
-                return MUSTACH_ERROR_BAD_SEPARATORS;
             oplen = l;
-            tmp = alloca(oplen + 1);
-            memcpy(tmp, beg, oplen);
-            tmp[oplen] = 0;
-            opstr = tmp;
             while (l < len && isspace(beg[l])) l++;
-            if (l == len)
-                return MUSTACH_ERROR_BAD_SEPARATORS;
+            if (oplen == len || l == len) {
+                rc = MUSTACH_ERROR_BAD_SEPARATORS;
+                break;
+            }
             cllen = len - l;
-            tmp = alloca(cllen + 1);
-            memcpy(tmp, beg + l, cllen);
-            tmp[cllen] = 0;
-            clstr = tmp;
+            rc = compiler_string(comp, beg, oplen, 1, &delims);
+            if (rc == MUSTACH_OK)
+                rc = compiler_string(comp, beg + l, cllen, 1, &offset);
             break;
         case '^':
         case '#':
             /* begin section */
-            if (depth == MUSTACH_MAX_DEPTH)
-                return MUSTACH_ERROR_TOO_DEEP;
-            rc = enabled;
-            if (rc) {
-                rc = iwrap->enter(iwrap->closure, name);
-                if (rc < 0)
-                    return rc;
+            if (comp->depth == MUSTACH_MAX_DEPTH) {
+                rc = MUSTACH_ERROR_TOO_DEEP;
+                break;
+            }
+            /* until closed, the jump of a section links to the enclosing open section */
+            rc = compiler_name(comp, beg, len, &offset, &symbol);
+            if (rc == MUSTACH_OK)
+                rc = compiler_op(comp, c == '#' ? MUSTACH_OP_SECTION : MUSTACH_OP_INVERTED, offset, len, open, symbol);
+            if (rc == MUSTACH_OK) {
+                open = comp->count;
+                depth++;
+                comp->depth++;
             }
-            stack[depth].name = beg;
-            stack[depth].again = template;
-            stack[depth].length = len;
-            stack[depth].enabled = enabled;
-            stack[depth].entered = rc;
-            if ((c == '#') == (rc == 0))
-                enabled = 0;
-            depth++;
             break;
         case '/':
             /* end section */
-            if (depth-- == 0 || len != stack[depth].length || memcmp(stack[depth].name, name, len))
-                return MUSTACH_ERROR_CLOSING;
-            rc = enabled && stack[depth].entered ? iwrap->next(iwrap->closure) : 0;
-            if (rc < 0)
-                return rc;
-            if (rc) {
-                template = stack[depth++].again;
-            } else {
-                enabled = stack[depth].enabled;
-                if (enabled && stack[depth].entered)
-                    iwrap->leave(iwrap->closure);
+            if (open == 0
+             || len != comp->ops[open - 1].length
+             || memcmp(&comp->pool[comp->ops[open - 1].offset], beg, len)) {
+                rc = MUSTACH_ERROR_CLOSING;
+                break;
             }
+            l = open - 1;
+            open = comp->ops[l].jump;
+            depth--;
+            comp->depth--;
+            comp->ops[l].jump = (uint32_t)comp->count;
+            rc = compiler_op(comp, MUSTACH_OP_END, comp->ops[l].offset, len, l, comp->ops[l].symbol);
             break;
         case '>':
             /* partials */
-            if (enabled) {
-                sbuf_reset(&sbuf);
-                rc = iwrap->partial(iwrap->closure_partial, name, &sbuf);
-                if (rc >= 0) {
-                    rc = process(sbuf.value, iwrap, file, opstr, clstr);
-                    sbuf_release(&sbuf);
-                }
-                if (rc < 0)
-                    return rc;
-            }
+            rc = compiler_partial(comp, beg, len, delims, chain);
             break;
         default:
             /* replacement */
-            if (enabled) {
-                rc = iwrap->put(iwrap->closure_put, name, c != '&', file);
-                if (rc < 0)
-                    return rc;
-            }
+            rc = compiler_name(comp, beg, len, &offset, &symbol);
+            if (rc == MUSTACH_OK)
+                rc = compiler_op(comp, c == '&' ? MUSTACH_OP_PUT_RAW : MUSTACH_OP_PUT, offset, len, 0, symbol);
             break;
         }
+        if (rc == MUSTACH_OK)
+            compiler_cut(comp, depth, template, delims);
     }
+    return rc;
 }
 
-int fmustach(const char *template, struct mustach_itf *itf, void *closure, FILE *file)
+/*
+ * adds the partial 'name' of 'length': inlined when the compiler resolves
+ * it and it is not included recursively, otherwise resolved at rendering
+ */
+static int compiler_partial(struct compiler *comp, const char *name, size_t length, size_t delims, const struct inclusion *chain)
 {
+    const struct inclusion *iter;
+    struct inclusion inclusion;
+    struct mustach_sbuf sbuf;
+    size_t offset, symbol;
     int rc;
-    struct iwrap iwrap;
 
+    if (comp->partial != NULL && (chain == NULL || chain->depth < MUSTACH_MAX_INLINE_DEPTH)) {
+        for (iter = chain ; iter != NULL ; iter = iter->parent)
+            if (iter->length == length && !memcmp(iter->name, name, length))
+                break;
+        if (iter == NULL) {
+            sbuf_reset(&sbuf);
+            rc = comp->partial(comp->closure, name, length, &sbuf);
+            if (rc < 0)
+                return rc;
+            if (rc > 0) {
+                inclusion.parent = chain;
+                inclusion.name = name;
+                inclusion.length = length;
+                inclusion.depth = chain ? chain->depth + 1 : 1;
+                rc = compiler_parse(comp, sbuf.value, sbuf_length(&sbuf), delims, &inclusion);
+                sbuf_release(&sbuf);
+                return rc;
+            }
+        }
+    }
+    rc = compiler_name(comp, name, length, &offset, &symbol);
+    if (rc == MUSTACH_OK)
+        rc = compiler_op(comp, MUSTACH_OP_PARTIAL, offset, length, delims, symbol);
+    return rc;
+}
+
+/* prepares the pool for a template of 'length', returns the offset of the separators in 'delims' */
+static int compiler_start(struct compiler *comp, size_t length, const char *opstr, const char *clstr, size_t *delims)
+{
+    size_t oplen, cllen, offset;
+    int rc;
+
+    /* the pool never grows more than the template and the header, except for inlined partials */
+    oplen = strlen(opstr);
+    cllen = strlen(clstr);
+    rc = compiler_reserve(comp, sizeof(struct mustach_program) + length + oplen + cllen + 2);
+    if (rc < 0)
+        return rc;
+    comp->size = sizeof(struct mustach_program);
+
+    /* separators are recorded in the pool as "opstr\0clstr\0" */
+    rc = compiler_string(comp, opstr, oplen, 1, delims);
+    if (rc == MUSTACH_OK)
+        rc = compiler_string(comp, clstr, cllen, 1, &offset);
+    return rc;
+}
+
+static void compiler_release(struct compiler *comp)
+{
+    free(comp->ops);
+    free(comp->pool);
+    free(comp->symbols);
+    free(comp->hash);
+    free(comp->segments);
+}
+
+/* compiles the 'template' with the separators 'opstr' and 'clstr', its texts not copied if 'inplace' */
+static int compile(const char *template, size_t length, const char *opstr, const char *clstr,
+                   int (*partial)(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf),
+                   void *closure, int inplace, struct mustach_program **program)
+{
+    struct compiler comp;
+    size_t delims;
+    int rc;
+
+    if (inplace && length > UINT32_MAX) {
+        errno = E2BIG;
+        return MUSTACH_ERROR_SYSTEM;
+    }
+    memset(&comp, 0, sizeof comp);
+    comp.partial = partial;
+    comp.closure = closure;
+    comp.base = inplace ? template : NULL;
+
+    rc = compiler_start(&comp, inplace ? 0 : length, opstr, clstr, &delims);
+    if (rc == MUSTACH_OK)
+        rc = compiler_parse(&comp, template, length, delims, NULL);
+    if (rc == MUSTACH_OK)
+        rc = compiler_link(&comp, program);
+    compiler_release(&comp);
+    return rc;
+}
+
+/*
+ * compiles in 'program' the longest prefix of 'template' made of complete
+ * top level units, the whole template if 'final', and returns the length
+ * of that prefix in 'consumed'. The separators in effect, "opstr\0clstr\0"
+ * allocated in 'delims', are updated for the rest of the template.
+ * The program is NULL if the prefix has no operation.
+ */
+static int compile_unit(const char *template, size_t length, int final, char **delims, struct mustach_program **program, size_t *consumed)
+{
+    struct compiler comp;
+    const char *opstr;
+    char *newdelims;
+    size_t start, oplen, cllen;
+    int rc;
+
+    *program = NULL;
+    *consumed = 0;
+    memset(&comp, 0, sizeof comp);
+    comp.stream = !final;
+    comp.cut = template;
+    opstr = *delims;
+    rc = compiler_start(&comp, length, opstr, opstr + strlen(opstr) + 1, &start);
+    comp.cutdelims = start;
+    if (rc == MUSTACH_OK)
+        rc = compiler_parse(&comp, template, length, start, NULL);
+    if (rc == COMPILER_MORE) {
+        /* keeps the complete units, and their separators for the rest */
+        rc = MUSTACH_OK;
+        comp.count = comp.cutcount;
+        length = (size_t)(comp.cut - template);
+        if (comp.cutdelims != start) {
+            opstr = &comp.pool[comp.cutdelims];
+            oplen = strlen(opstr);
+            cllen = strlen(&opstr[oplen + 1]);
+            newdelims = malloc(oplen + cllen + 2);
+            if (newdelims == NULL)
+                rc = MUSTACH_ERROR_SYSTEM;
+            else {
+                memcpy(newdelims, opstr, oplen + cllen + 2);
+                free(*delims);
+                *delims = newdelims;
+            }
+        }
+    }
+    if (rc == MUSTACH_OK && comp.count)
+        rc = compiler_link(&comp, program);
+    if (rc == MUSTACH_OK)
+        *consumed = length;
+    compiler_release(&comp);
+    return rc;
+}
+
+/*
+ * Cache of partials
+ *
+ * The partials are compiled once and kept by name and delimiters, the
+ * delimiters in effect where the partial is included being part of its
+ * compiled form. The most recently used partial is kept first.
+ */
+struct partial {
+    struct partial *next;
+    struct mustach_program *program;
+    size_t length;  /* length of the name */
+    char key[];     /* name, opstr and clstr, zero terminated */
+};
+
+struct mustach_partials {
+    struct partial *list;
+};
+
+static const struct mustach_program *partials_get(struct mustach_partials *partials, const char *name, size_t length, const char *opstr, const char *clstr)
+{
+    struct partial *part, **prv;
+    const char *delim;
+
+    for (prv = &partials->list ; (part = *prv) != NULL ; prv = &part->next) {
+        if (part->length == length && !memcmp(part->key, name, length)) {
+            delim = &part->key[length + 1];
+            if (!strcmp(delim, opstr) && !strcmp(delim + strlen(delim) + 1, clstr)) {
+                *prv = part->next;
+                part->next = partials->list;
+                partials->list = part;
+                return part->program;
+            }
+        }
+    }
+    return NULL;
+}
+
+static int partials_add(struct mustach_partials *partials, const char *name, size_t length, const char *opstr, const char *clstr, struct mustach_program *program)
+{
+    struct partial *part;
+    size_t oplen, cllen;
+
+    oplen = strlen(opstr);
+    cllen = strlen(clstr);
+    part = malloc(sizeof *part + length + oplen + cllen + 3);
+    if (part == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    part->program = program;
+    part->length = length;
+    memcpy(part->key, name, length);
+    part->key[length] = 0;
+    memcpy(&part->key[length + 1], opstr, oplen + 1);
+    memcpy(&part->key[length + oplen + 2], clstr, cllen + 1);
+    part->next = partials->list;
+    partials->list = part;
+    return MUSTACH_OK;
+}
+
+/*
+ * walks the segments of the dotted 'symbol' with the child callbacks,
+ * the last one is entered if 'sbuf' is NULL or else gets its value
+ */
+static int iwrap_walk(struct iwrap *iwrap, const struct mustach_program *program, unsigned symbol, struct mustach_sbuf *sbuf)
+{
+    const struct mustach_symbol *symbols, *seg;
+    const uint32_t *path;
+    unsigned i, last, id;
+    int rc;
+
+    symbols = program_symbols(program);
+    path = program_segments(program) + symbols[symbol].path;
+    last = symbols[symbol].count - 1;
+    rc = 1;
+    for (i = 0 ; rc > 0 && i <= last ; i++) {
+        seg = &symbols[path[i]];
+        id = program == iwrap->program ? path[i] : MUSTACH_NO_SYMBOL;
+        if (i < last)
+            rc = iwrap->get_child(iwrap->closure, i == 0, program_string(program, seg->offset), seg->length, id, NULL);
+        else if (sbuf)
+            rc = iwrap->get_child(iwrap->closure, i == 0, program_string(program, seg->offset), seg->length, id, sbuf);
+        else
+            rc = iwrap->enter_child(iwrap->closure, program_string(program, seg->offset), seg->length, id);
+    }
+    return rc;
+}
+
+static int iwrap_put_child(struct iwrap *iwrap, const struct mustach_program *program, unsigned symbol, int escape, struct sink *sink)
+{
+    int rc;
+    struct mustach_sbuf sbuf;
+    size_t length;
+
+    sbuf_reset(&sbuf);
+    rc = iwrap_walk(iwrap, program, symbol, &sbuf);
+    if (rc > 0) {
+        length = sbuf_length(&sbuf);
+        rc = length ? iwrap_emit(iwrap, sink, sbuf.value, length, escape) : MUSTACH_OK;
+        sbuf_release(&sbuf);
+    }
+    return rc;
+}
+
+static int iwrap_enter(struct iwrap *iwrap, const struct mustach_program *program, const struct mustach_op *op)
+{
+    if (iwrap->enter_child && program_symbols(program)[op->symbol].count)
+        return iwrap_walk(iwrap, program, op->symbol, NULL);
+    if (iwrap->enter_by_id && program == iwrap->program)
+        return iwrap->enter_by_id(iwrap->closure, op->symbol);
+    return iwrap->enter(iwrap->closure, program_string(program, op->offset), op->length);
+}
+
+/*
+ * returns in 'partial' the program of the partial of 'op', fetched and
+ * compiled once when the callback 'partial' returns 0. The texts given by
+ * 'get' or 'put', or by 'partial' returning 1, depend on the context: they
+ * are compiled at each inclusion and 'owned' receives the program that the
+ * caller frees.
+ */
+static int iwrap_partial_program(struct iwrap *iwrap, const struct mustach_program *program, const struct mustach_op *op,
+                                 const struct mustach_program **partial, struct mustach_program **owned)
+{
+    struct mustach_sbuf sbuf;
+    struct mustach_program *compiled;
+    const char *name, *opstr, *clstr;
+    int rc, keep;
+
+    name = program_string(program, op->offset);
+    opstr = program_string(program, op->jump);
+    clstr = opstr + strlen(opstr) + 1;
+    *owned = NULL;
+    *partial = iwrap->cached ? partials_get(iwrap->partials, name, op->length, opstr, clstr) : NULL;
+    if (*partial != NULL)
+        return MUSTACH_OK;
+
+    sbuf_reset(&sbuf);
+    rc = iwrap->partial(iwrap->closure_partial, name, op->length, &sbuf);
+    if (rc >= 0) {
+        keep = iwrap->cached && rc == 0;
+        rc = compile(sbuf.value, sbuf_length(&sbuf), opstr, clstr, NULL, NULL, 0, &compiled);
+        sbuf_release(&sbuf);
+        if (rc >= 0 && !keep)
+            *partial = *owned = compiled;
+        else if (rc >= 0) {
+            rc = partials_add(iwrap->partials, name, op->length, opstr, clstr, compiled);
+            if (rc < 0)
+                free(compiled);
+            else
+                *partial = compiled;
+        }
+    }
+    return rc;
+}
+
+/*
+ * Execution of programs
+ *
+ * The executed programs are stacked in frames allocated on the heap: a
+ * partial pushes the frame of its program and the frame is popped at its
+ * end, so the execution never recurses and uses memory in proportion of
+ * the actual nesting of partials. The first frames are kept in the state
+ * of the execution, the usual renderings don't allocate them.
+ */
+struct frame {
+    const struct mustach_program *program;
+    const struct mustach_op *op;  /* the next operation */
+    const struct mustach_op *end; /* the end of the operations */
+    struct mustach_program *owned; /* the program to free when popped */
+};
+
+/* count of frames of the executions not needing allocation */
+#define EXEC_FRAMES 8
+
+struct exec {
+    struct frame *frames;
+    struct frame inline_frames[EXEC_FRAMES];
+    unsigned depth;    /* count of frames in use */
+    unsigned count;    /* count of frames allocated */
+    unsigned maxdepth; /* maximum count of frames */
+    int pause;         /* when set, the execution stops after the current operation */
+};
+
+static void exec_init(struct exec *exec, const struct mustach_options *options)
+{
+    exec->frames = exec->inline_frames;
+    exec->depth = 0;
+    exec->count = EXEC_FRAMES;
+    exec->maxdepth = 1 + (options && options->max_depth ? options->max_depth : MUSTACH_MAX_DEPTH);
+    exec->pause = 0;
+}
+
+static void exec_release(struct exec *exec)
+{
+    while (exec->depth)
+        free(exec->frames[--exec->depth].owned);
+    if (exec->frames != exec->inline_frames)
+        free(exec->frames);
+}
+
+static int exec_push(struct exec *exec, const struct mustach_program *program)
+{
+    struct frame *frames;
+    unsigned count;
+
+    if (exec->depth == exec->maxdepth)
+        return MUSTACH_ERROR_TOO_DEEP;
+    if (exec->depth == exec->count) {
+        count = 2 * exec->count;
+        if (exec->frames != exec->inline_frames)
+            frames = realloc(exec->frames, count * sizeof *frames);
+        else if ((frames = malloc(count * sizeof *frames)) != NULL)
+            memcpy(frames, exec->inline_frames, sizeof exec->inline_frames);
+        if (frames == NULL)
+            return MUSTACH_ERROR_SYSTEM;
+        exec->frames = frames;
+        exec->count = count;
+    }
+    frames = &exec->frames[exec->depth++];
+    frames->program = program;
+    frames->op = program_ops(program);
+    frames->end = frames->op + program->count;
+    frames->owned = NULL;
+    return MUSTACH_OK;
+}
+
+/* executes the operations of the frames until none remains or until paused */
+static int execute(struct exec *exec, struct iwrap *iwrap, struct sink *sink)
+{
+    struct frame *frame;
+    const struct mustach_program *program, *partial;
+    struct mustach_program *owned;
+    const struct mustach_op *ops, *op;
+    int rc;
+
+    while (exec->depth && !exec->pause) {
+        frame = &exec->frames[exec->depth - 1];
+        if (frame->op == frame->end) {
+            free(frame->owned);
+            exec->depth--;
+            continue;
+        }
+        program = frame->program;
+        ops = program_ops(program);
+        op = frame->op++;
+        switch(op->code) {
+        case MUSTACH_OP_TEXT:
+            if (program == sink->program && iwrap->emit == NULL)
+                rc = sink->refer(sink, program_text(program, op), op->length);
+            else
+                rc = iwrap_emit(iwrap, sink, program_text(program, op), op->length, 0);
+            break;
+        case MUSTACH_OP_SECTION:
+            /* begin section, skipped at once when not entered */
+            rc = iwrap_enter(iwrap, program, op);
+            if (rc == 0)
+                frame->op = &ops[op->jump + 1];
+            break;
+        case MUSTACH_OP_INVERTED:
+            /* begin inverted section, skipped at once when entered */
+            rc = iwrap_enter(iwrap, program, op);
+            if (rc > 0) {
+                iwrap->leave(iwrap->closure);
+                frame->op = &ops[op->jump + 1];
+            }
+            break;
+        case MUSTACH_OP_END:
+            /* end section, the inverted sections reaching here were not entered */
+            rc = 0;
+            if (ops[op->jump].code == MUSTACH_OP_SECTION) {
+                rc = iwrap->next(iwrap->closure);
+                if (rc > 0)
+                    /* iterates the body again */
+                    frame->op = &ops[op->jump + 1];
+                else if (rc == 0)
+                    iwrap->leave(iwrap->closure);
+            }
+            break;
+        case MUSTACH_OP_PARTIAL:
+            /* partials, the frame may move when pushing */
+            rc = iwrap_partial_program(iwrap, program, op, &partial, &owned);
+            if (rc >= 0)
+                rc = exec_push(exec, partial);
+            if (rc >= 0)
+                exec->frames[exec->depth - 1].owned = owned;
+            else
+                free(owned);
+            break;
+        default:
+            /* replacement */
+            if (iwrap->get_child && program_symbols(program)[op->symbol].count)
+                rc = iwrap_put_child(iwrap, program, op->symbol, op->code == MUSTACH_OP_PUT, sink);
+            else if (iwrap->get_by_id && program == iwrap->program)
+                rc = iwrap_put_by_id(iwrap, op->symbol, op->code == MUSTACH_OP_PUT, sink);
+            else
+                rc = iwrap_put(iwrap, sink, program_string(program, op->offset), op->length, op->code == MUSTACH_OP_PUT);
+            break;
+        }
+        if (rc < 0)
+            return rc;
+    }
+    return MUSTACH_OK;
+}
+
+static int iwrap_init(struct iwrap *iwrap, struct mustach_itf2 *itf, void *closure)
+{
     /* check validity */
     if (!itf->enter || !itf->next || !itf->leave || (!itf->put && !itf->get))
         return MUSTACH_ERROR_INVALID_ITF;
 
     /* init wrap structure */
-    iwrap.closure = closure;
-    if (itf->put) {
-        iwrap.put = itf->put;
-        iwrap.closure_put = closure;
-    } else {
-        iwrap.put = iwrap_put;
-        iwrap.closure_put = &iwrap;
-    }
+    iwrap->closure = closure;
+    iwrap->put = itf->put;
+    iwrap->cached = itf->partial != NULL;
     if (itf->partial) {
-        iwrap.partial = itf->partial;
-        iwrap.closure_partial = closure;
+        iwrap->partial = itf->partial;
+        iwrap->closure_partial = closure;
     } else if (itf->get) {
-        iwrap.partial = itf->get;
-        iwrap.closure_partial = closure;
+        iwrap->partial = itf->get;
+        iwrap->closure_partial = closure;
     } else {
-        iwrap.partial = iwrap_partial;
-        iwrap.closure_partial = &iwrap;
+        iwrap->partial = iwrap_partial;
+        iwrap->closure_partial = iwrap;
     }
-    iwrap.emit = itf->emit ? itf->emit : iwrap_emit;
-    iwrap.enter = itf->enter;
-    iwrap.next = itf->next;
-    iwrap.leave = itf->leave;
-    iwrap.get = itf->get;
+    iwrap->emit = itf->emit;
+    iwrap->enter = itf->enter;
+    iwrap->next = itf->next;
+    iwrap->leave = itf->leave;
+    iwrap->get = itf->get;
+    iwrap->enter_by_id = itf->enter_by_id;
+    iwrap->get_by_id = itf->put ? NULL : itf->get_by_id;
+    iwrap->get_child = itf->put ? NULL : itf->get_child;
+    iwrap->enter_child = iwrap->get_child ? itf->enter_child : NULL;
+    iwrap->program = NULL;
+    iwrap->partials = NULL;
+    return MUSTACH_OK;
+}
 
-    /* process */
-    rc = itf->start ? itf->start(closure) : 0;
-    if (rc == 0)
-        rc = process(template, &iwrap, file, "{{", "}}");
+/*
+ * Adaptation of the historic interface
+ *
+ * The names given to the callbacks of the historic interface must be
+ * zero terminated: they are taken from the pool of the program where
+ * names are always zero terminated.
+ */
+static int adapter_start(void *closure)
+{
+    struct mustach_adapter *adapter = closure;
+    return adapter->itf->start(adapter->closure);
+}
+
+static int adapter_put(void *closure, const char *name, size_t length, int escape, FILE *file)
+{
+    struct mustach_adapter *adapter = closure;
+    (void)length; /* unused */
+    return adapter->itf->put(adapter->closure, name, escape, file);
+}
+
+static int adapter_enter(void *closure, const char *name, size_t length)
+{
+    struct mustach_adapter *adapter = closure;
+    (void)length; /* unused */
+    return adapter->itf->enter(adapter->closure, name);
+}
+
+static int adapter_next(void *closure)
+{
+    struct mustach_adapter *adapter = closure;
+    return adapter->itf->next(adapter->closure);
+}
+
+static int adapter_leave(void *closure)
+{
+    struct mustach_adapter *adapter = closure;
+    return adapter->itf->leave(adapter->closure);
+}
+
+static int adapter_partial(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    struct mustach_adapter *adapter = closure;
+    (void)length; /* unused */
+    return adapter->itf->partial(adapter->closure, name, sbuf);
+}
+
+static int adapter_emit(void *closure, const char *buffer, size_t size, int escape, FILE *file)
+{
+    struct mustach_adapter *adapter = closure;
+    return adapter->itf->emit(adapter->closure, buffer, size, escape, file);
+}
+
+static int adapter_get(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    struct mustach_adapter *adapter = closure;
+    (void)length; /* unused */
+    return adapter->itf->get(adapter->closure, name, sbuf);
+}
+
+static void adapter_stop(void *closure, int status)
+{
+    struct mustach_adapter *adapter = closure;
+    adapter->itf->stop(adapter->closure, status);
+}
+
+void mustach_adapt(struct mustach_adapter *adapter, struct mustach_itf *itf, void *closure)
+{
+    memset(&adapter->itf2, 0, sizeof adapter->itf2);
+    adapter->itf = itf;
+    adapter->closure = closure;
+    if (itf->start)
+        adapter->itf2.start = adapter_start;
+    if (itf->put)
+        adapter->itf2.put = adapter_put;
+    if (itf->enter)
+        adapter->itf2.enter = adapter_enter;
+    if (itf->next)
+        adapter->itf2.next = adapter_next;
+    if (itf->leave)
+        adapter->itf2.leave = adapter_leave;
+    if (itf->partial)
+        adapter->itf2.partial = adapter_partial;
+    if (itf->emit)
+        adapter->itf2.emit = adapter_emit;
+    if (itf->get)
+        adapter->itf2.get = adapter_get;
     if (itf->stop)
-        itf->stop(closure, rc);
+        adapter->itf2.stop = adapter_stop;
+}
+
+/*
+ * Estimation of the outputs
+ *
+ * The buffers are allocated at once to the expected size of the output:
+ * the total length of the texts of the program, or the running estimate
+ * of the previous outputs when it is bigger.
+ */
+size_t mustach_size_hint(const struct mustach_program *program, const struct mustach_options *options)
+{
+    size_t hint, estimate;
+
+    hint = program->texts;
+    if (options != NULL) {
+        if (options->estimate != NULL) {
+            /* with some room for the outputs a bit bigger than usual */
+            estimate = __atomic_load_n(options->estimate, __ATOMIC_RELAXED);
+            estimate += estimate / 8;
+            if (estimate > hint)
+                hint = estimate;
+        }
+        if (options->capacity > hint)
+            hint = options->capacity;
+    }
+    return hint;
+}
+
+/* updates the running estimate of 'options' with the 'size' of an output */
+static void estimate_update(const struct mustach_options *options, size_t size)
+{
+    size_t estimate;
+
+    if (options != NULL && options->estimate != NULL) {
+        /* follows the growths at once and the shrinks slowly */
+        estimate = __atomic_load_n(options->estimate, __ATOMIC_RELAXED);
+        estimate = size >= estimate ? size : estimate - (estimate - size) / 8;
+        __atomic_store_n(options->estimate, estimate, __ATOMIC_RELAXED);
+    }
+}
+
+/*
+ * Entry points
+ *
+ * A job is either a compiled program or a template to compile, rendered
+ * for an interface and its closure.
+ */
+struct job {
+    const struct mustach_program *program;
+    const char *template;
+    size_t length;
+    struct mustach_itf2 *itf;
+    void *closure;
+    const struct mustach_options *options;
+    int (*read)(void *closure, char *buffer, size_t size, size_t *count);
+    void *reader; /* closure of read, reading the template if not NULL */
+};
+
+/* size of the chunks read when streaming templates */
+#define STREAM_CHUNK 65536
+
+/*
+ * renders the template read by chunks: the complete top level units read
+ * so far are compiled and executed at once, so that only the units not
+ * yet complete, like the bodies of open sections, are kept in memory
+ */
+static int job_stream(struct job *job, struct iwrap *iwrap, struct exec *exec, struct sink *sink)
+{
+    struct mustach_program *program;
+    char *buffer, *grown, *delims;
+    size_t length, size, count, consumed, retry;
+    int rc, final;
+
+    buffer = NULL;
+    length = size = retry = 0;
+    final = 0;
+    delims = malloc(6);
+    if (delims == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    memcpy(delims, "{{\0}}", 6);
+    rc = MUSTACH_OK;
+    while (rc == MUSTACH_OK) {
+        if (size - length < STREAM_CHUNK) {
+            size = size ? 2 * size : STREAM_CHUNK;
+            while (size - length < STREAM_CHUNK)
+                size *= 2;
+            grown = realloc(buffer, size);
+            if (grown == NULL) {
+                rc = MUSTACH_ERROR_SYSTEM;
+                break;
+            }
+            buffer = grown;
+        }
+        rc = job->read(job->reader, &buffer[length], size - length, &count);
+        if (rc < 0)
+            break;
+        final = count == 0;
+        length += count;
+        /* retries incomplete units after they doubled, the reading stays linear */
+        if (!final && length < retry)
+            continue;
+        rc = compile_unit(buffer, length, final, &delims, &program, &consumed);
+        if (rc == MUSTACH_OK && program != NULL) {
+            rc = exec_push(exec, program);
+            if (rc == MUSTACH_OK)
+                rc = execute(exec, iwrap, sink);
+            free(program);
+        }
+        if (final)
+            break;
+        length -= consumed;
+        memmove(buffer, &buffer[consumed], length);
+        retry = 2 * length;
+    }
+    free(buffer);
+    free(delims);
     return rc;
 }
 
-int fdmustach(const char *template, struct mustach_itf *itf, void *closure, int fd)
+static int job_sink(struct job *job, struct sink *sink)
 {
     int rc;
-    FILE *file;
+    struct iwrap iwrap;
+    struct exec exec;
+    struct mustach_program *program;
+    struct mustach_partials partials = { NULL };
 
-    file = fdopen(fd, "w");
-    if (file == NULL) {
-        rc = MUSTACH_ERROR_SYSTEM;
-        errno = ENOMEM;
-    } else {
-        rc = fmustach(template, itf, closure, file);
-        fclose(file);
+    rc = iwrap_init(&iwrap, job->itf, job->closure);
+    if (rc < 0)
+        return rc;
+
+    /* partials are kept for the rendering or as long as the caller wants */
+    iwrap.partials = job->options && job->options->partials ? job->options->partials : &partials;
+
+    /* process */
+    rc = job->itf->start ? job->itf->start(job->closure) : 0;
+    if (rc == 0) {
+        exec_init(&exec, job->options);
+        if (job->read != NULL)
+            rc = job_stream(job, &iwrap, &exec, sink);
+        else {
+            program = NULL;
+            if (job->program == NULL)
+                rc = compile(job->template, job->length, "{{", "}}", NULL, NULL, 1, &program);
+            if (rc == 0) {
+                iwrap.program = program ? program : job->program;
+                rc = exec_push(&exec, iwrap.program);
+                if (rc == 0)
+                    rc = execute(&exec, &iwrap, sink);
+            }
+            free(program);
+        }
+        exec_release(&exec);
     }
+    if (job->itf->stop)
+        job->itf->stop(job->closure, rc);
+    mustach_partials_invalidate(&partials, NULL, 0);
     return rc;
 }
 
-int mustach(const char *template, struct mustach_itf *itf, void *closure, char **result, size_t *size)
+static int job_file(struct job *job, FILE *file)
+{
+    struct sink sink = { .write = sink_file_write, .file = file };
+    return job_sink(job, &sink);
+}
+
+/* size of the buffer of the renderings in file descriptors, by default */
+#define SINK_FD_BUFFER 4096
+
+static int job_fd(struct job *job, int fd)
+{
+    char buffer[SINK_FD_BUFFER];
+    struct sink sink;
+    int rc, rc2;
+
+    memset(&sink, 0, sizeof sink);
+    sink.write = sink_fd_write;
+    sink.fd = fd;
+    sink.capacity = job->options && job->options->buffer ? job->options->buffer : sizeof buffer;
+    if (sink.capacity <= sizeof buffer)
+        sink.data = buffer;
+    else {
+        sink.data = malloc(sink.capacity);
+        if (sink.data == NULL)
+            return MUSTACH_ERROR_SYSTEM;
+    }
+    rc = job_sink(job, &sink);
+    sink_close(&sink);
+    /* what was rendered is written, even on error as a stream would do, unless a write failed */
+    rc2 = sink_fd_flush(&sink);
+    if (sink.data != buffer)
+        free(sink.data);
+    return rc < 0 ? rc : rc2;
+}
+
+static int job_mem(struct job *job, char **result, size_t *size)
 {
     int rc;
-    FILE *file;
-    size_t s;
+    struct sink sink;
+    size_t s, capacity;
 
-    *result = NULL;
     if (size == NULL)
         size = &s;
-    file = memfile_open(result, size);
-    if (file == NULL)
-        rc = MUSTACH_ERROR_SYSTEM;
-    else {
-        rc = fmustach(template, itf, closure, file);
-        if (rc < 0)
-            memfile_abort(file, result, size);
-        else
-            rc = memfile_close(file, result, size);
-    }
+    if (job->program != NULL)
+        capacity = mustach_size_hint(job->program, job->options) + 1; /* with the terminating zero */
+    else
+        capacity = job->options ? job->options->capacity : 0;
+    rc = sink_mem_open(&sink, capacity);
+    if (rc == MUSTACH_OK)
+        rc = job_sink(job, &sink);
+    rc = sink_mem_close(&sink, rc, result, size);
+    if (rc == MUSTACH_OK)
+        estimate_update(job->options, *size);
     return rc;
 }
 
+/* initialize the job for the historic interface */
+static struct job *job_adapt(struct job *job, struct mustach_adapter *adapter, struct mustach_itf *itf, void *closure)
+{
+    mustach_adapt(adapter, itf, closure);
+    job->itf = &adapter->itf2;
+    job->closure = adapter;
+    return job;
+}
+
+int mustach_file(const char *template, size_t length, struct mustach_itf *itf, void *closure, FILE *file)
+{
+    struct mustach_adapter adapter;
+    struct job job = { .template = template, .length = length };
+    return job_file(job_adapt(&job, &adapter, itf, closure), file);
+}
+
+int mustach_fd(const char *template, size_t length, struct mustach_itf *itf, void *closure, int fd)
+{
+    struct mustach_adapter adapter;
+    struct job job = { .template = template, .length = length };
+    return job_fd(job_adapt(&job, &adapter, itf, closure), fd);
+}
+
+int mustach_mem(const char *template, size_t length, struct mustach_itf *itf, void *closure, char **result, size_t *size)
+{
+    struct mustach_adapter adapter;
+    struct job job = { .template = template, .length = length };
+    return job_mem(job_adapt(&job, &adapter, itf, closure), result, size);
+}
+
+int fmustach(const char *template, struct mustach_itf *itf, void *closure, FILE *file)
+{
+    return mustach_file(template, strlen(template), itf, closure, file);
+}
+
+int fdmustach(const char *template, struct mustach_itf *itf, void *closure, int fd)
+{
+    return mustach_fd(template, strlen(template), itf, closure, fd);
+}
+
+int mustach(const char *template, struct mustach_itf *itf, void *closure, char **result, size_t *size)
+{
+    return mustach_mem(template, strlen(template), itf, closure, result, size);
+}
+
+int mustach_compile(const char *template, size_t length, struct mustach_program **program)
+{
+    *program = NULL;
+    return compile(template, length, "{{", "}}", NULL, NULL, 0, program);
+}
+
+int mustach_compile_inplace(const char *template, size_t length, struct mustach_program **program)
+{
+    *program = NULL;
+    return compile(template, length, "{{", "}}", NULL, NULL, 1, program);
+}
+
+int mustach_compile_inline(const char *template, size_t length,
+                           int (*partial)(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf),
+                           void *closure, struct mustach_program **program)
+{
+    *program = NULL;
+    return compile(template, length, "{{", "}}", partial, closure, 0, program);
+}
+
+int mustach_exec(const struct mustach_program *program, struct mustach_itf *itf, void *closure, FILE *file)
+{
+    struct mustach_adapter adapter;
+    struct job job = { .program = program };
+    return job_file(job_adapt(&job, &adapter, itf, closure), file);
+}
+
+int mustach_exec2(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, FILE *file)
+{
+    struct job job = { .program = program, .itf = itf, .closure = closure, .options = options };
+    return job_file(&job, file);
+}
+
+int mustach_exec2_fd(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, int fd)
+{
+    struct job job = { .program = program, .itf = itf, .closure = closure, .options = options };
+    return job_fd(&job, fd);
+}
+
+int mustach_exec2_mem(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, char **result, size_t *size)
+{
+    struct job job = { .program = program, .itf = itf, .closure = closure, .options = options };
+    return job_mem(&job, result, size);
+}
+
+int mustach_exec2_write(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options,
+                        int (*write)(void *writer, const char *buffer, size_t size), void *writer)
+{
+    struct job job = { .program = program, .itf = itf, .closure = closure, .options = options };
+    struct sink sink;
+    int rc;
+
+    memset(&sink, 0, sizeof sink);
+    sink.write = sink_writer_write;
+    sink.writer = write;
+    sink.closure = writer;
+    rc = job_sink(&job, &sink);
+    sink_close(&sink);
+    if (rc < 0)
+        return rc;
+    estimate_update(options, sink.length);
+    return MUSTACH_OK;
+}
+
+int mustach_exec2_buffer(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options,
+                         char *buffer, size_t capacity, size_t *length)
+{
+    struct job job = { .program = program, .itf = itf, .closure = closure, .options = options };
+    struct sink sink;
+    int rc;
+
+    memset(&sink, 0, sizeof sink);
+    sink.write = sink_buffer_write;
+    sink.data = buffer;
+    sink.capacity = capacity;
+    rc = job_sink(&job, &sink);
+    sink_close(&sink);
+    if (rc < 0)
+        return rc;
+    if (sink.length >= capacity) {
+        *length = sink.length + 1;
+        return MUSTACH_ERROR_TOO_SMALL;
+    }
+    buffer[sink.length] = 0;
+    *length = sink.length;
+    return MUSTACH_OK;
+}
+
+/*
+ * Step-wise rendering
+ *
+ * The rendering writes in a sink whose writes fill the buffer given to
+ * the current step. The execution pauses after the operation that fills
+ * it, the bytes that didn't fit being kept pending for the next step.
+ */
+struct mustach_render {
+    struct iwrap iwrap;
+    struct exec exec;
+    struct mustach_itf2 *itf;
+    void *closure;
+    struct mustach_partials partials;
+    struct sink sink;
+    char *buffer;    /* buffer of the current step */
+    size_t capacity; /* its capacity */
+    size_t written;  /* count of bytes written in it */
+    char *pending;   /* bytes written beyond the capacity */
+    size_t npending, apending, opending;
+    int status;      /* 1 while rendering, then the final status */
+};
+
+static int render_write(struct sink *sink, const char *data, size_t size)
+{
+    struct mustach_render *render = sink->closure;
+    char *pending;
+    size_t n, asize;
+
+    n = render->capacity - render->written;
+    if (n > size)
+        n = size;
+    if (n) {
+        memcpy(&render->buffer[render->written], data, n);
+        render->written += n;
+    }
+    if (n < size) {
+        if (render->npending + size - n > render->apending) {
+            asize = render->apending ? render->apending : 256;
+            while (asize < render->npending + size - n)
+                asize *= 2;
+            pending = realloc(render->pending, asize);
+            if (pending == NULL) {
+                errno = ENOMEM;
+                return MUSTACH_ERROR_SYSTEM;
+            }
+            render->pending = pending;
+            render->apending = asize;
+        }
+        memcpy(&render->pending[render->npending], &data[n], size - n);
+        render->npending += size - n;
+    }
+    if (render->written == render->capacity)
+        render->exec.pause = 1;
+    return MUSTACH_OK;
+}
+
+int mustach_render_create(struct mustach_render **result, const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options)
+{
+    struct mustach_render *render;
+    int rc;
+
+    *result = NULL;
+    render = calloc(1, sizeof *render);
+    if (render == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    rc = iwrap_init(&render->iwrap, itf, closure);
+    if (rc == MUSTACH_OK) {
+        render->sink.write = render_write;
+        render->sink.closure = render;
+        render->itf = itf;
+        render->closure = closure;
+        render->iwrap.program = program;
+        render->iwrap.partials = options && options->partials ? options->partials : &render->partials;
+        exec_init(&render->exec, options);
+        rc = exec_push(&render->exec, program);
+        /* as for the other renderings, any status but 0 of 'start' stops */
+        if (rc == MUSTACH_OK && itf->start) {
+            rc = itf->start(closure);
+            if (rc != 0 && itf->stop)
+                itf->stop(closure, rc);
+        }
+    }
+    if (rc < 0) {
+        exec_release(&render->exec);
+        free(render);
+        return rc;
+    }
+    render->status = rc > 0 ? MUSTACH_OK : 1;
+    *result = render;
+    return rc;
+}
+
+int mustach_step(struct mustach_render *render, char *buffer, size_t capacity, size_t *written)
+{
+    size_t n;
+    int rc;
+
+    /* without room, the rendering could not progress */
+    *written = 0;
+    if (capacity == 0)
+        return MUSTACH_ERROR_TOO_SMALL;
+
+    render->buffer = buffer;
+    render->capacity = capacity;
+    render->written = 0;
+
+    /* first the pending bytes */
+    n = render->npending - render->opending;
+    if (n > capacity)
+        n = capacity;
+    if (n) {
+        memcpy(buffer, &render->pending[render->opending], n);
+        render->written = n;
+        render->opending += n;
+    }
+    if (render->opending == render->npending)
+        render->opending = render->npending = 0;
+
+    /* then the execution, until the buffer is full */
+    if (render->status == 1 && render->npending == 0 && render->written < capacity) {
+        render->exec.pause = 0;
+        rc = execute(&render->exec, &render->iwrap, &render->sink);
+        if (rc < 0 || render->exec.depth == 0) {
+            render->status = rc < 0 ? rc : MUSTACH_OK;
+            if (render->itf->stop)
+                render->itf->stop(render->closure, render->status);
+        }
+    }
+    *written = render->written;
+    if (render->status < 0)
+        return render->status;
+    return render->status == 1 || render->npending != 0;
+}
+
+void mustach_render_free(struct mustach_render *render)
+{
+    if (render != NULL) {
+        if (render->status == 1 && render->itf->stop)
+            render->itf->stop(render->closure, MUSTACH_ERROR_ABORTED);
+        sink_close(&render->sink);
+        exec_release(&render->exec);
+        mustach_partials_invalidate(&render->partials, NULL, 0);
+        free(render->pending);
+        free(render);
+    }
+}
+
+/*
+ * Scatter-gather rendering
+ *
+ * The texts of the program are referenced where they are, the other
+ * bytes are copied in blocks that are never moved: the output is the
+ * list of segments of these texts and copies.
+ */
+struct iov_block {
+    struct iov_block *next;
+    char data[];
+};
+
+struct mustach_iov {
+    struct iovec *segments;
+    int count;           /* count of segments */
+    int acount;          /* allocated count */
+    size_t length;       /* total length */
+    struct iov_block *blocks; /* the blocks of copies, the last first */
+    char *top;           /* free space of the last block */
+    size_t available;    /* its size */
+    size_t size;         /* the size of the last block */
+};
+
+/* size of the first block of copies, the next ones double */
+#define IOV_BLOCK 4096
+
+/* texts shorter than that are copied, a segment would cost more */
+#define IOV_REFER_MIN 32
+
+/* adds a segment of 'size' bytes at 'buffer', joined to the last one when contiguous */
+static int iov_push(struct mustach_iov *iov, const char *buffer, size_t size)
+{
+    struct iovec *segments, *last;
+    int acount;
+
+    last = iov->count ? &iov->segments[iov->count - 1] : NULL;
+    if (last != NULL && (const char*)last->iov_base + last->iov_len == buffer)
+        last->iov_len += size;
+    else {
+        if (iov->count == iov->acount) {
+            acount = iov->acount ? 2 * iov->acount : 64;
+            segments = realloc(iov->segments, (size_t)acount * sizeof *segments);
+            if (segments == NULL) {
+                errno = ENOMEM;
+                return MUSTACH_ERROR_SYSTEM;
+            }
+            iov->segments = segments;
+            iov->acount = acount;
+        }
+        iov->segments[iov->count].iov_base = (void*)buffer;
+        iov->segments[iov->count++].iov_len = size;
+    }
+    iov->length += size;
+    return MUSTACH_OK;
+}
+
+static int iov_write(struct sink *sink, const char *buffer, size_t size)
+{
+    struct mustach_iov *iov = sink->closure;
+    struct iov_block *block;
+    size_t bsize;
+    int rc;
+
+    if (size == 0)
+        return MUSTACH_OK;
+    if (size <= iov->available && iov->count && (char*)iov->segments[iov->count - 1].iov_base + iov->segments[iov->count - 1].iov_len == iov->top) {
+        /* most writes extend the last copy */
+        memcpy(iov->top, buffer, size);
+        iov->segments[iov->count - 1].iov_len += size;
+        iov->length += size;
+        iov->top += size;
+        iov->available -= size;
+        return MUSTACH_OK;
+    }
+    if (size > iov->available) {
+        bsize = iov->size ? 2 * iov->size : IOV_BLOCK;
+        while (bsize < size)
+            bsize *= 2;
+        block = malloc(sizeof *block + bsize);
+        if (block == NULL) {
+            errno = ENOMEM;
+            return MUSTACH_ERROR_SYSTEM;
+        }
+        block->next = iov->blocks;
+        iov->blocks = block;
+        iov->top = block->data;
+        iov->available = iov->size = bsize;
+    }
+    memcpy(iov->top, buffer, size);
+    rc = iov_push(iov, iov->top, size);
+    if (rc == MUSTACH_OK) {
+        iov->top += size;
+        iov->available -= size;
+    }
+    return rc;
+}
+
+static int iov_refer(struct sink *sink, const char *buffer, size_t size)
+{
+    if (size < IOV_REFER_MIN)
+        return iov_write(sink, buffer, size);
+    return size ? iov_push(sink->closure, buffer, size) : MUSTACH_OK;
+}
+
+int mustach_exec2_iov(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, struct mustach_iov **result)
+{
+    struct job job = { .program = program, .itf = itf, .closure = closure, .options = options };
+    struct mustach_iov *iov;
+    struct sink sink;
+    int rc;
+
+    *result = NULL;
+    iov = calloc(1, sizeof *iov);
+    if (iov == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    /* about a segment per operation, a hint growing as needed */
+    iov->acount = (int)program->count + 1;
+    iov->segments = malloc((size_t)iov->acount * sizeof *iov->segments);
+    if (iov->segments == NULL) {
+        free(iov);
+        return MUSTACH_ERROR_SYSTEM;
+    }
+    memset(&sink, 0, sizeof sink);
+    sink.write = iov_write;
+    sink.refer = iov_refer;
+    sink.program = program;
+    sink.closure = iov;
+    rc = job_sink(&job, &sink);
+    sink_close(&sink);
+    if (rc < 0)
+        mustach_iov_free(iov);
+    else {
+        estimate_update(options, iov->length);
+        *result = iov;
+        rc = MUSTACH_OK;
+    }
+    return rc;
+}
+
+int mustach_exec2_writev(const struct mustach_program *program, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, int fd)
+{
+    struct mustach_iov *iov;
+    int rc;
+
+    rc = mustach_exec2_iov(program, itf, closure, options, &iov);
+    if (rc == MUSTACH_OK) {
+        rc = mustach_iov_write(iov, fd);
+        mustach_iov_free(iov);
+    }
+    return rc;
+}
+
+const struct iovec *mustach_iov_segments(const struct mustach_iov *iov, int *count)
+{
+    *count = iov->count;
+    return iov->segments;
+}
+
+size_t mustach_iov_length(const struct mustach_iov *iov)
+{
+    return iov->length;
+}
+
+int mustach_iov_write(const struct mustach_iov *iov, int fd)
+{
+    return fd_writev(fd, iov->segments, iov->count);
+}
+
+void mustach_iov_free(struct mustach_iov *iov)
+{
+    struct iov_block *block;
+
+    if (iov != NULL) {
+        while ((block = iov->blocks) != NULL) {
+            iov->blocks = block->next;
+            free(block);
+        }
+        free(iov->segments);
+        free(iov);
+    }
+}
+
+static int fd_read(void *closure, char *buffer, size_t size, size_t *count)
+{
+    ssize_t n;
+
+    do {
+        n = read(*(int*)closure, buffer, size);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0)
+        return MUSTACH_ERROR_SYSTEM;
+    *count = (size_t)n;
+    return MUSTACH_OK;
+}
+
+int mustach_stream(int (*read)(void *closure, char *buffer, size_t size, size_t *count), void *reader,
+                   struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, FILE *file)
+{
+    struct job job = { .itf = itf, .closure = closure, .options = options, .read = read, .reader = reader };
+    return job_file(&job, file);
+}
+
+int mustach_stream_fd(int input, struct mustach_itf2 *itf, void *closure, const struct mustach_options *options, FILE *file)
+{
+    return mustach_stream(fd_read, &input, itf, closure, options, file);
+}
+
+void mustach_program_free(struct mustach_program *program)
+{
+    free(program);
+}
+
+int mustach_partials_create(struct mustach_partials **partials)
+{
+    *partials = calloc(1, sizeof **partials);
+    return *partials ? MUSTACH_OK : MUSTACH_ERROR_SYSTEM;
+}
+
+void mustach_partials_invalidate(struct mustach_partials *partials, const char *name, size_t length)
+{
+    struct partial *part, **prv;
+
+    prv = &partials->list;
+    while ((part = *prv) != NULL) {
+        if (name != NULL && (part->length != length || memcmp(part->key, name, length)))
+            prv = &part->next;
+        else {
+            *prv = part->next;
+            free(part->program);
+            free(part);
+        }
+    }
+}
+
+void mustach_partials_free(struct mustach_partials *partials)
+{
+    if (partials != NULL) {
+        mustach_partials_invalidate(partials, NULL, 0);
+        free(partials);
+    }
+}
+
+size_t mustach_program_size(const struct mustach_program *program)
+{
+    return program->size;
+}
+
+unsigned mustach_program_symbols(const struct mustach_program *program)
+{
+    return program->nsymbols;
+}
+
+size_t mustach_program_texts(const struct mustach_program *program)
+{
+    return program->texts;
+}
+
+unsigned mustach_program_count(const struct mustach_program *program)
+{
+    return program->count;
+}
+
+int mustach_program_op(const struct mustach_program *program, unsigned index, const char **text, size_t *length, unsigned *jump)
+{
+    const struct mustach_op *op;
+
+    if (index >= program->count)
+        return -1;
+    op = &program_ops(program)[index];
+    if (text)
+        *text = op->code == MUSTACH_OP_TEXT ? program_text(program, op) : program_string(program, op->offset);
+    if (length)
+        *length = op->length;
+    if (jump)
+        *jump = op->code == MUSTACH_OP_PARTIAL || op->code == MUSTACH_OP_TEXT ? 0 : op->jump;
+    return (int)op->code;
+}
+
+const char *mustach_program_symbol(const struct mustach_program *program, unsigned symbol, size_t *length)
+{
+    const struct mustach_symbol *sym;
+
+    if (symbol >= program->nsymbols)
+        return NULL;
+    sym = &program_symbols(program)[symbol];
+    if (length)
+        *length = sym->length;
+    return program_string(program, sym->offset);
+}
+
+/* header of the archives of compiled programs, see mustach_archive_write */
+struct archive {
+    char magic[8];    /* ARCHIVE_MAGIC */
+    uint32_t version; /* MUSTACH_ARCHIVE_VERSION, in the byte order of the writer */
+    uint32_t count;   /* count of entries, sorted by name */
+    uint32_t size;    /* size in bytes of the archive */
+    uint32_t names;   /* offset of the names */
+};
+
+struct archive_entry {
+    uint32_t name;    /* offset of the name */
+    uint32_t length;  /* length of the name */
+    uint32_t program; /* offset of the program, aligned on 8 bytes */
+    uint32_t size;    /* size of the program */
+};
+
+#define ARCHIVE_MAGIC "mustach\032"
+
+struct mustach_archive {
+    const char *data;
+    size_t size;
+    int mapped; /* 1 if mapped, -1 if allocated, 0 if given */
+    signed char checked[]; /* per program: 0 if not checked yet, 1 if valid, -1 if corrupted */
+};
+
+/* checks that the 'program' of 'size' bytes is consistent: it can be rendered safely */
+static int program_check(const struct mustach_program *program, size_t size)
+{
+    const struct mustach_op *ops, *op;
+    const struct mustach_symbol *symbols, *sym;
+    const uint32_t *segments;
+    const char *pool;
+    uint32_t open[MUSTACH_MAX_DEPTH], i, j, nsegments;
+    size_t depth, end;
+    uint64_t texts;
+
+    if (size < sizeof *program || ((uintptr_t)program & 7) != 0 || program->size != size
+     || program->ops < sizeof *program || program->ops > size || (program->ops & 7) != 0
+     || program->count > (size - program->ops) / sizeof *ops
+     || program->symbols != program->ops + program->count * sizeof *ops
+     || program->nsymbols > (size - program->symbols) / sizeof *symbols
+     || program->segments != program->symbols + program->nsymbols * sizeof *symbols
+     || (size - program->segments) % sizeof *segments != 0 || program->text != 0)
+        return MUSTACH_ERROR_BAD_ARCHIVE;
+
+    /* strings are in the pool, names are zero terminated */
+    pool = (const char*)program;
+    end = program->ops;
+    ops = program_ops(program);
+    symbols = program_symbols(program);
+    segments = program_segments(program);
+    nsegments = (uint32_t)((size - program->segments) / sizeof *segments);
+    for (i = 0 ; i < program->nsymbols ; i++) {
+        sym = &symbols[i];
+        if (sym->offset >= end || sym->length >= end - sym->offset || pool[sym->offset + sym->length]
+         || sym->path > nsegments || sym->count > nsegments - sym->path)
+            return MUSTACH_ERROR_BAD_ARCHIVE;
+        for (j = 0 ; j < sym->count ; j++)
+            if (segments[sym->path + j] >= program->nsymbols)
+                return MUSTACH_ERROR_BAD_ARCHIVE;
+    }
+
+    /* sections are nested and linked to their ends */
+    depth = 0;
+    texts = 0;
+    for (i = 0 ; i < program->count ; i++) {
+        op = &ops[i];
+        if (op->code == MUSTACH_OP_TEXT) {
+            if (op->offset > end || op->length > end - op->offset)
+                return MUSTACH_ERROR_BAD_ARCHIVE;
+            texts += op->length;
+            continue;
+        }
+        if (op->code > MUSTACH_OP_PARTIAL || op->symbol >= program->nsymbols
+         || op->offset >= end || op->length >= end - op->offset || pool[op->offset + op->length])
+            return MUSTACH_ERROR_BAD_ARCHIVE;
+        switch (op->code) {
+        case MUSTACH_OP_SECTION:
+        case MUSTACH_OP_INVERTED:
+            if (depth == MUSTACH_MAX_DEPTH || op->jump <= i || op->jump >= program->count)
+                return MUSTACH_ERROR_BAD_ARCHIVE;
+            open[depth++] = i;
+            break;
+        case MUSTACH_OP_END:
+            if (depth == 0 || op->jump != open[--depth] || ops[op->jump].jump != i)
+                return MUSTACH_ERROR_BAD_ARCHIVE;
+            break;
+        case MUSTACH_OP_PARTIAL:
+            /* the separators "opstr\0clstr\0", not empty */
+            if (op->jump >= end || (j = (uint32_t)strnlen(&pool[op->jump], end - op->jump)) == 0
+             || j >= end - op->jump - 1 || pool[op->jump + j + 1] == 0
+             || strnlen(&pool[op->jump + j + 1], end - op->jump - j - 1) == end - op->jump - j - 1)
+                return MUSTACH_ERROR_BAD_ARCHIVE;
+            break;
+        default:
+            break;
+        }
+    }
+    if (program->texts != (texts < UINT32_MAX ? texts : UINT32_MAX))
+        return MUSTACH_ERROR_BAD_ARCHIVE;
+    return depth ? MUSTACH_ERROR_BAD_ARCHIVE : MUSTACH_OK;
+}
+
+static int compare_names(const char *name1, size_t length1, const char *name2, size_t length2)
+{
+    int rc = memcmp(name1, name2, length1 < length2 ? length1 : length2);
+    return rc ? rc : length1 < length2 ? -1 : length1 > length2;
+}
+
+struct archive_item {
+    const char *name;
+    size_t length;
+    const struct mustach_program *program;
+};
+
+static int compare_items(const void *item1, const void *item2)
+{
+    const struct archive_item *i1 = item1, *i2 = item2;
+    return compare_names(i1->name, i1->length, i2->name, i2->length);
+}
+
+static int archive_put(FILE *file, const void *data, size_t size)
+{
+    return size == 0 || fwrite(data, size, 1, file) == 1 ? MUSTACH_OK : MUSTACH_ERROR_SYSTEM;
+}
+
+int mustach_archive_write(FILE *file, const char *const *names, const struct mustach_program *const *programs, unsigned count)
+{
+    static const char padding[8];
+    struct archive header;
+    struct archive_entry entry;
+    struct archive_item *items;
+    size_t i, base, offset, lnames;
+    int rc;
+
+    items = malloc((count ? count : 1) * sizeof *items);
+    if (items == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    lnames = 0;
+    for (i = 0 ; i < count ; i++) {
+        items[i].name = names[i];
+        items[i].length = strlen(names[i]);
+        items[i].program = programs[i];
+        lnames += items[i].length + 1;
+    }
+    qsort(items, count, sizeof *items, compare_items);
+
+    /* layout: header, entries, names, then the programs aligned on 8 bytes */
+    rc = MUSTACH_OK;
+    header.names = (uint32_t)(sizeof header + count * sizeof entry);
+    base = offset = (header.names + lnames + 7) & ~(size_t)7;
+    for (i = 0 ; i < count ; i++) {
+        if ((i && !compare_items(&items[i - 1], &items[i])) || items[i].program->text != 0)
+            rc = MUSTACH_ERROR_BAD_ARCHIVE;
+        offset = (offset + items[i].program->size + 7) & ~(size_t)7;
+    }
+    if (offset > UINT32_MAX)
+        rc = MUSTACH_ERROR_BAD_ARCHIVE;
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof header.magic);
+    header.version = MUSTACH_ARCHIVE_VERSION;
+    header.count = count;
+    header.size = (uint32_t)offset;
+    if (rc == MUSTACH_OK)
+        rc = archive_put(file, &header, sizeof header);
+
+    lnames = 0;
+    offset = base;
+    for (i = 0 ; rc == MUSTACH_OK && i < count ; i++) {
+        entry.name = (uint32_t)(header.names + lnames);
+        entry.length = (uint32_t)items[i].length;
+        entry.program = (uint32_t)offset;
+        entry.size = items[i].program->size;
+        rc = archive_put(file, &entry, sizeof entry);
+        lnames += items[i].length + 1;
+        offset = (offset + items[i].program->size + 7) & ~(size_t)7;
+    }
+    for (i = 0 ; rc == MUSTACH_OK && i < count ; i++)
+        rc = archive_put(file, items[i].name, items[i].length + 1);
+    if (rc == MUSTACH_OK)
+        rc = archive_put(file, padding, base - header.names - lnames);
+    for (i = 0 ; rc == MUSTACH_OK && i < count ; i++) {
+        rc = archive_put(file, items[i].program, items[i].program->size);
+        if (rc == MUSTACH_OK)
+            rc = archive_put(file, padding, -(size_t)items[i].program->size & 7);
+    }
+    free(items);
+    return rc;
+}
+
+/* checks the header and the entries of the archive, its programs are checked when found */
+static int archive_check(const char *data, size_t size)
+{
+    const struct archive *header = (const struct archive*)data;
+    const struct archive_entry *entries;
+    uint32_t i;
+
+    if (size < sizeof *header || ((uintptr_t)data & 7) != 0 || memcmp(header->magic, ARCHIVE_MAGIC, sizeof header->magic)
+     || header->version != MUSTACH_ARCHIVE_VERSION || header->size != size
+     || header->count > (size - sizeof *header) / sizeof *entries
+     || header->names != sizeof *header + header->count * sizeof *entries)
+        return MUSTACH_ERROR_BAD_ARCHIVE;
+    entries = (const struct archive_entry*)&header[1];
+    for (i = 0 ; i < header->count ; i++) {
+        if (entries[i].name < header->names || entries[i].name >= size || entries[i].length >= size - entries[i].name
+         || data[entries[i].name + entries[i].length]
+         || entries[i].program > size || entries[i].size > size - entries[i].program
+         || (i && compare_names(&data[entries[i - 1].name], entries[i - 1].length, &data[entries[i].name], entries[i].length) >= 0))
+            return MUSTACH_ERROR_BAD_ARCHIVE;
+    }
+    return MUSTACH_OK;
+}
+
+int mustach_archive_map(struct mustach_archive **archive, const void *data, size_t size)
+{
+    struct mustach_archive *arch;
+    size_t count;
+    int rc;
+
+    rc = archive_check(data, size);
+    if (rc < 0)
+        return rc;
+    count = ((const struct archive*)data)->count;
+    arch = calloc(1, sizeof *arch + count);
+    if (arch == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    arch->data = data;
+    arch->size = size;
+    arch->mapped = 0;
+    *archive = arch;
+    return MUSTACH_OK;
+}
+
+int mustach_archive_open(struct mustach_archive **archive, const char *path)
+{
+    struct stat st;
+    void *data;
+    int fd, rc, mapped;
+#if defined(NO_MMAP_FOR_MUSTACH)
+    ssize_t n;
+    size_t length;
+#endif
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return MUSTACH_ERROR_SYSTEM;
+    rc = fstat(fd, &st);
+    if (rc < 0 || st.st_size == 0 || (uintmax_t)st.st_size > UINT32_MAX) {
+        close(fd);
+        return rc < 0 ? MUSTACH_ERROR_SYSTEM : MUSTACH_ERROR_BAD_ARCHIVE;
+    }
+#if !defined(NO_MMAP_FOR_MUSTACH)
+    /* the programs are rendered in place */
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    mapped = 1;
+    if (data == MAP_FAILED)
+        data = NULL;
+#else
+    data = malloc((size_t)st.st_size);
+    mapped = -1;
+    length = 0;
+    while (data != NULL && length < (size_t)st.st_size) {
+        n = read(fd, (char*)data + length, (size_t)st.st_size - length);
+        if (n > 0)
+            length += (size_t)n;
+        else if (n == 0 || errno != EINTR) {
+            free(data);
+            data = NULL;
+        }
+    }
+#endif
+    close(fd);
+    if (data == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    rc = mustach_archive_map(archive, data, (size_t)st.st_size);
+    if (rc < 0) {
+#if !defined(NO_MMAP_FOR_MUSTACH)
+        munmap(data, (size_t)st.st_size);
+#else
+        free(data);
+#endif
+        return rc;
+    }
+    (*archive)->mapped = mapped;
+    return MUSTACH_OK;
+}
+
+int mustach_archive_find(const struct mustach_archive *archive, const char *name, size_t length, const struct mustach_program **program)
+{
+    const struct archive *header = (const struct archive*)archive->data;
+    const struct archive_entry *entries = (const struct archive_entry*)&header[1], *entry;
+    signed char *checked;
+    uint32_t low, high, mid;
+    int cmp;
+
+    low = 0;
+    high = header->count;
+    while (low < high) {
+        mid = low + (high - low) / 2;
+        entry = &entries[mid];
+        cmp = compare_names(name, length, &archive->data[entry->name], entry->length);
+        if (cmp == 0) {
+            /* checked once, the concurrent finds may check it both */
+            *program = (const struct mustach_program*)&archive->data[entry->program];
+            checked = (signed char*)&archive->checked[mid];
+            if (__atomic_load_n(checked, __ATOMIC_RELAXED) == 0)
+                __atomic_store_n(checked, program_check(*program, entry->size) < 0 ? -1 : 1, __ATOMIC_RELAXED);
+            return __atomic_load_n(checked, __ATOMIC_RELAXED) > 0 ? MUSTACH_OK : MUSTACH_ERROR_BAD_ARCHIVE;
+        }
+        if (cmp < 0)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return MUSTACH_ERROR_ITEM_NOT_FOUND;
+}
+
+unsigned mustach_archive_count(const struct mustach_archive *archive)
+{
+    return ((const struct archive*)archive->data)->count;
+}
+
+const char *mustach_archive_name(const struct mustach_archive *archive, unsigned index, size_t *length)
+{
+    const struct archive *header = (const struct archive*)archive->data;
+    const struct archive_entry *entry;
+
+    if (index >= header->count)
+        return NULL;
+    entry = &((const struct archive_entry*)&header[1])[index];
+    if (length)
+        *length = entry->length;
+    return &archive->data[entry->name];
+}
+
+void mustach_archive_close(struct mustach_archive *archive)
+{
+    if (archive != NULL) {
+#if !defined(NO_MMAP_FOR_MUSTACH)
+        if (archive->mapped > 0)
+            munmap((void*)archive->data, archive->size);
+#endif
+        if (archive->mapped < 0)
+            free((void*)archive->data);
+        free(archive);
+    }
+}
@@ -0,0 +1,114 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define TEMPLATES 2000
+
+/* the templates of a service: pages differing by their titles */
+static const char page[] =
+    "<html><head><title>Page %u</title></head><body>\n"
+    "<h1>{{title}}</h1>\n"
+    "{{#rows}}<p class=\"row\">{{id}}: {{name}}</p>\n{{/rows}}"
+    "{{^rows}}<p>nothing</p>{{/rows}}\n"
+    "<footer>{{user.name}} - {{user.mail}}</footer></body></html>\n";
+
+static struct bench_value *data(void)
+{
+    struct bench_value *root, *user;
+
+    user = bench_object(2);
+    bench_set(user, 0, "name", bench_string("John"));
+    bench_set(user, 1, "mail", bench_string("john@example.com"));
+    root = bench_object(3);
+    bench_set(root, 0, "title", bench_string("Title"));
+    bench_set(root, 1, "rows", bench_array(0));
+    bench_set(root, 2, "user", user);
+    return root;
+}
+
+void bench_archive(void)
+{
+    static char texts[TEMPLATES][sizeof page + 16];
+    static char names[TEMPLATES][16];
+    static struct mustach_program *programs[TEMPLATES];
+    const char *pnames[TEMPLATES];
+    const struct mustach_program *program;
+    struct bench_value *root = data();
+    struct bench_context context;
+    struct mustach_archive *archive;
+    char path[] = "/tmp/mustach-bench-XXXXXX";
+    FILE *file;
+    size_t i, j, count = 20;
+    double t;
+    int fd;
+
+    for (i = 0 ; i < TEMPLATES ; i++) {
+        snprintf(texts[i], sizeof texts[i], page, (unsigned)i);
+        snprintf(names[i], sizeof names[i], "page%zu", i);
+        pnames[i] = names[i];
+    }
+
+    /* the cold start of a service: each template is prepared once */
+    t = bench_now();
+    for (j = 0 ; j < count ; j++) {
+        for (i = 0 ; i < TEMPLATES ; i++)
+            bench_check(mustach_compile(texts[i], strlen(texts[i]), &programs[i]), "mustach_compile");
+        if (j + 1 < count)
+            for (i = 0 ; i < TEMPLATES ; i++)
+                mustach_program_free(programs[i]);
+    }
+    bench_report("compile 2000 templates from text", bench_now() - t, count);
+
+    fd = mkstemp(path);
+    file = fd < 0 ? NULL : fdopen(fd, "wb");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    bench_check(mustach_archive_write(file, pnames, (const struct mustach_program *const*)programs, TEMPLATES), "mustach_archive_write");
+    fclose(file);
+    for (i = 0 ; i < TEMPLATES ; i++)
+        mustach_program_free(programs[i]);
+
+    t = bench_now();
+    for (j = 0 ; j < count ; j++) {
+        bench_check(mustach_archive_open(&archive, path), "mustach_archive_open");
+        for (i = 0 ; i < TEMPLATES ; i++)
+            bench_check(mustach_archive_find(archive, names[i], strlen(names[i]), &program), "mustach_archive_find");
+        if (j + 1 < count)
+            mustach_archive_close(archive);
+    }
+    bench_report("open archive of 2000 templates", bench_now() - t, count);
+
+    /* the programs are rendered in place */
+    t = bench_now();
+    for (i = 0 ; i < TEMPLATES ; i++) {
+        bench_check(mustach_archive_find(archive, names[i], strlen(names[i]), &program), "mustach_archive_find");
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2(program, &bench_itf2, &context, NULL, bench_null()), "mustach_exec2");
+    }
+    bench_report("mustach_exec2 from the archive", bench_now() - t, TEMPLATES);
+    mustach_archive_close(archive);
+
+    unlink(path);
+    bench_free(root);
+}
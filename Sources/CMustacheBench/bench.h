@@ -0,0 +1,89 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef _bench_h_included_
+#define _bench_h_included_
+#include <stdio.h>
+
+#include "mustach.h"
+
+/**
+ * bench_value - a minimal tree of data for rendering
+ *
+ * @type:   one of BENCH_STRING, BENCH_OBJECT, BENCH_ARRAY
+ * @string: the value of BENCH_STRING
+ * @length: the length of the value of BENCH_STRING
+ * @count:  count of fields of BENCH_OBJECT or of items of BENCH_ARRAY
+ * @names:  names of the fields of BENCH_OBJECT
+ * @items:  values of the fields of BENCH_OBJECT or items of BENCH_ARRAY
+ */
+struct bench_value {
+    enum { BENCH_STRING, BENCH_OBJECT, BENCH_ARRAY } type;
+    const char *string;
+    size_t length;
+    size_t count;
+    const char **names;
+    struct bench_value *items;
+};
+
+/**
+ * bench_context - closure of 'bench_itf' rendering a 'bench_value'
+ */
+struct bench_context {
+    struct { struct bench_value *value; size_t index; } stack[MUSTACH_MAX_DEPTH];
+    int depth;
+    struct bench_value *cursor;
+};
+
+/* interfaces rendering bench_context (get based, emit with FILE) */
+extern struct mustach_itf bench_itf;
+extern struct mustach_itf2 bench_itf2;
+
+/* same as bench_itf2 with the walk of dotted names done by the engine */
+extern struct mustach_itf2 bench_itf2_child;
+
+extern void bench_context_init(struct bench_context *context, struct bench_value *root);
+
+/* builders of values, they never fail (abort on memory exhaustion) */
+extern struct bench_value *bench_string(const char *string);
+extern struct bench_value *bench_object(size_t count);
+extern struct bench_value *bench_array(size_t count);
+extern void bench_set(struct bench_value *object, size_t index, const char *name, struct bench_value *value);
+extern void bench_free(struct bench_value *value);
+
+/* helpers */
+extern double bench_now(void);
+extern FILE *bench_null(void);
+extern void bench_report(const char *label, double seconds, size_t count);
+extern void bench_check(int rc, const char *what);
+
+/* benchmarks */
+extern void bench_compile(void);
+extern void bench_interface(void);
+extern void bench_loop(void);
+extern void bench_skip(void);
+extern void bench_scan(void);
+extern void bench_dotted(void);
+extern void bench_partials(void);
+extern void bench_delimiters(void);
+extern void bench_nesting(void);
+extern void bench_stream(void);
+extern void bench_archive(void);
+extern void bench_memory(void);
+extern void bench_iov(void);
+extern void bench_buffer(void);
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+/* a log line and its message, a partial only depending on its name */
+static const char line[] =
+    "{{level}} [{{module}}] {{#user}}user={{name}} {{/user}}{{>message}}\n";
+static const char message[] = "request of {{path}} in {{time}} ms";
+
+static int partial(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    (void)closure; /* unused */
+    if (length == 7 && !memcmp(name, "message", 7)) {
+        sbuf->value = message;
+        sbuf->length = sizeof message - 1;
+    }
+    return MUSTACH_OK;
+}
+
+static struct bench_value *data(void)
+{
+    struct bench_value *root, *user;
+
+    user = bench_object(1);
+    bench_set(user, 0, "name", bench_string("john"));
+    root = bench_object(5);
+    bench_set(root, 0, "level", bench_string("INFO"));
+    bench_set(root, 1, "module", bench_string("http"));
+    bench_set(root, 2, "user", user);
+    bench_set(root, 3, "path", bench_string("/index"));
+    bench_set(root, 4, "time", bench_string("12"));
+    return root;
+}
+
+void bench_buffer(void)
+{
+    struct bench_value *root = data();
+    struct bench_context context;
+    struct mustach_program *program;
+    struct mustach_partials *partials;
+    struct mustach_itf2 itf = bench_itf2;
+    struct mustach_options options = { NULL };
+    char buffer[256], *result;
+    size_t i, length, count = 100000;
+    double t;
+
+    bench_check(mustach_compile(line, sizeof line - 1, &program), "mustach_compile");
+    bench_check(mustach_partials_create(&partials), "mustach_partials_create");
+    options.partials = partials;
+    itf.partial = partial;
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2_mem(program, &itf, &context, &options, &result, &length), "mustach_exec2_mem");
+        free(result);
+    }
+    bench_report("exec2_mem", bench_now() - t, count);
+
+    /* the partial is compiled by the first rendering, then found in the cache */
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2_buffer(program, &itf, &context, &options, buffer, sizeof buffer, &length), "mustach_exec2_buffer");
+    }
+    bench_report("exec2_buffer", bench_now() - t, count);
+
+    mustach_partials_free(partials);
+    mustach_program_free(program);
+    bench_free(root);
+}
@@ -0,0 +1,123 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <string.h>
+
+#include "bench.h"
+
+/* a typical page: mostly literal text, a few values and small sections */
+static const char page[] =
+    "<!DOCTYPE html>\n<html>\n<head>\n  <meta charset=\"utf-8\">\n"
+    "  <title>{{title}} - {{site}}</title>\n"
+    "  <link rel=\"stylesheet\" href=\"/static/main.css\">\n</head>\n<body>\n"
+    "  <header class=\"top\"><a href=\"/\">{{site}}</a>\n"
+    "  {{#user}}<span class=\"user\">Hello {{name}}</span>{{/user}}\n"
+    "  {{^user}}<a href=\"/login\">Sign in</a>{{/user}}</header>\n"
+    "  <main>\n    <h1>{{title}}</h1>\n    <p class=\"lead\">{{lead}}</p>\n"
+    "    <ul class=\"menu\">\n{{#menu}}      <li><a href=\"{{href}}\">{{label}}</a></li>\n{{/menu}}    </ul>\n"
+    "    {{! comments are dropped by the compiler }}\n"
+    "    <article>{{{body}}}</article>\n  </main>\n"
+    "  <footer>&copy; {{year}} {{site}} - <a href=\"/about\">About</a> - <a href=\"/contact\">Contact</a></footer>\n"
+    "</body>\n</html>\n";
+
+static struct bench_value *data(void)
+{
+    static const char *labels[] = { "Home", "News", "Blog", "Shop", "Help" };
+    static const char *hrefs[] = { "/", "/news", "/blog", "/shop", "/help" };
+    struct bench_value *root, *user, *menu, *item;
+    size_t i;
+
+    menu = bench_array(5);
+    for (i = 0 ; i < 5 ; i++) {
+        item = bench_object(2);
+        bench_set(item, 0, "href", bench_string(hrefs[i]));
+        bench_set(item, 1, "label", bench_string(labels[i]));
+        bench_set(menu, i, NULL, item);
+    }
+    user = bench_object(1);
+    bench_set(user, 0, "name", bench_string("Ada"));
+    root = bench_object(8);
+    bench_set(root, 0, "title", bench_string("Benchmarks & results"));
+    bench_set(root, 1, "site", bench_string("example.org"));
+    bench_set(root, 2, "user", user);
+    bench_set(root, 3, "lead", bench_string("Rendering <compiled> templates"));
+    bench_set(root, 4, "menu", menu);
+    bench_set(root, 5, "body", bench_string("<p>Lorem ipsum dolor sit amet.</p>"));
+    bench_set(root, 6, "year", bench_string("2024"));
+    bench_set(root, 7, "unused", bench_string(""));
+    return root;
+}
+
+void bench_compile(void)
+{
+    struct bench_value *root = data();
+    struct bench_context context;
+    struct mustach_program *program;
+    size_t i, count = 200000;
+    double t;
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(fmustach(page, &bench_itf, &context, bench_null()), "fmustach");
+    }
+    bench_report("fmustach (parse each render)", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_check(mustach_compile(page, strlen(page), &program), "mustach_compile");
+        mustach_program_free(program);
+    }
+    bench_report("mustach_compile", bench_now() - t, count);
+
+    bench_check(mustach_compile(page, strlen(page), &program), "mustach_compile");
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec(program, &bench_itf, &context, bench_null()), "mustach_exec");
+    }
+    bench_report("mustach_exec (compiled once)", bench_now() - t, count);
+    mustach_program_free(program);
+
+    bench_free(root);
+}
+
+void bench_interface(void)
+{
+    struct bench_value *root = data();
+    struct bench_context context;
+    struct mustach_program *program;
+    size_t i, count = 200000;
+    double t;
+
+    bench_check(mustach_compile(page, strlen(page), &program), "mustach_compile");
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec(program, &bench_itf, &context, bench_null()), "mustach_exec");
+    }
+    bench_report("mustach_exec (mustach_itf)", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2(program, &bench_itf2, &context, NULL, bench_null()), "mustach_exec2");
+    }
+    bench_report("mustach_exec2 (mustach_itf2)", bench_now() - t, count);
+    mustach_program_free(program);
+
+    bench_free(root);
+}
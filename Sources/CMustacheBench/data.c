@@ -0,0 +1,231 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+static void *xcalloc(size_t count, size_t size)
+{
+    void *result = calloc(count, size);
+    if (result == NULL)
+        abort();
+    return result;
+}
+
+struct bench_value *bench_string(const char *string)
+{
+    struct bench_value *value = xcalloc(1, sizeof *value);
+    value->type = BENCH_STRING;
+    value->string = string;
+    value->length = strlen(string);
+    return value;
+}
+
+struct bench_value *bench_object(size_t count)
+{
+    struct bench_value *value = xcalloc(1, sizeof *value);
+    value->type = BENCH_OBJECT;
+    value->count = count;
+    value->names = xcalloc(count ? count : 1, sizeof *value->names);
+    value->items = xcalloc(count ? count : 1, sizeof *value->items);
+    return value;
+}
+
+struct bench_value *bench_array(size_t count)
+{
+    struct bench_value *value = bench_object(count);
+    value->type = BENCH_ARRAY;
+    return value;
+}
+
+void bench_set(struct bench_value *object, size_t index, const char *name, struct bench_value *value)
+{
+    object->names[index] = name;
+    object->items[index] = *value;
+    free(value);
+}
+
+static void release(struct bench_value *value)
+{
+    size_t i;
+
+    if (value->type != BENCH_STRING) {
+        for (i = 0 ; i < value->count ; i++)
+            release(&value->items[i]);
+        free(value->names);
+        free(value->items);
+    }
+}
+
+void bench_free(struct bench_value *value)
+{
+    release(value);
+    free(value);
+}
+
+void bench_context_init(struct bench_context *context, struct bench_value *root)
+{
+    context->stack[0].value = root;
+    context->stack[0].index = 0;
+    context->depth = 1;
+}
+
+static struct bench_value *field(struct bench_value *value, const char *name, size_t length)
+{
+    size_t i;
+
+    if (value->type != BENCH_OBJECT)
+        return NULL;
+    for (i = 0 ; i < value->count ; i++)
+        if (!strncmp(value->names[i], name, length) && !value->names[i][length])
+            return &value->items[i];
+    return NULL;
+}
+
+static struct bench_value *current(struct bench_context *context, int depth)
+{
+    struct bench_value *value = context->stack[depth].value;
+    return value->type == BENCH_ARRAY ? &value->items[context->stack[depth].index] : value;
+}
+
+static struct bench_value *lookup(struct bench_context *context, const char *name, size_t length)
+{
+    struct bench_value *value;
+    const char *dot, *end = name + length;
+    int depth;
+
+    if (length == 1 && name[0] == '.')
+        return current(context, context->depth - 1);
+    dot = memchr(name, '.', length);
+    for (depth = context->depth ; depth-- ; ) {
+        value = field(current(context, depth), name, (size_t)((dot ? dot : end) - name));
+        if (value != NULL) {
+            while (value != NULL && dot != NULL) {
+                name = dot + 1;
+                dot = memchr(name, '.', (size_t)(end - name));
+                value = field(value, name, (size_t)((dot ? dot : end) - name));
+            }
+            return value;
+        }
+    }
+    return NULL;
+}
+
+static int push(struct bench_context *context, struct bench_value *value)
+{
+    if (value == NULL
+     || (value->type == BENCH_ARRAY && value->count == 0)
+     || (value->type == BENCH_STRING && (!value->string[0] || !strcmp(value->string, "false"))))
+        return 0;
+    if (context->depth == MUSTACH_MAX_DEPTH)
+        return MUSTACH_ERROR_TOO_DEEP;
+    context->stack[context->depth].value = value;
+    context->stack[context->depth].index = 0;
+    context->depth++;
+    return 1;
+}
+
+static int enter2(void *closure, const char *name, size_t length)
+{
+    return push(closure, lookup(closure, name, length));
+}
+
+static int next(void *closure)
+{
+    struct bench_context *context = closure;
+    int depth = context->depth - 1;
+
+    if (context->stack[depth].value->type != BENCH_ARRAY
+     || context->stack[depth].index + 1 >= context->stack[depth].value->count)
+        return 0;
+    context->stack[depth].index++;
+    return 1;
+}
+
+static int leave(void *closure)
+{
+    struct bench_context *context = closure;
+    context->depth--;
+    return MUSTACH_OK;
+}
+
+static int get2(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    struct bench_value *value = lookup(closure, name, length);
+
+    if (value != NULL && value->type == BENCH_STRING) {
+        sbuf->value = value->string;
+        sbuf->length = value->length;
+    }
+    return MUSTACH_OK;
+}
+
+static int get_child(void *closure, int first, const char *name, size_t length, unsigned symbol, struct mustach_sbuf *sbuf)
+{
+    struct bench_context *context = closure;
+    (void)symbol; /* unused */
+
+    context->cursor = first ? lookup(context, name, length) : field(context->cursor, name, length);
+    if (context->cursor == NULL)
+        return 0;
+    if (sbuf != NULL && context->cursor->type == BENCH_STRING) {
+        sbuf->value = context->cursor->string;
+        sbuf->length = context->cursor->length;
+    }
+    return 1;
+}
+
+static int enter_child(void *closure, const char *name, size_t length, unsigned symbol)
+{
+    struct bench_context *context = closure;
+    (void)symbol; /* unused */
+    return push(context, field(context->cursor, name, length));
+}
+
+static int enter(void *closure, const char *name)
+{
+    return enter2(closure, name, strlen(name));
+}
+
+static int get(void *closure, const char *name, struct mustach_sbuf *sbuf)
+{
+    return get2(closure, name, strlen(name), sbuf);
+}
+
+struct mustach_itf bench_itf = {
+    .enter = enter,
+    .next = next,
+    .leave = leave,
+    .get = get,
+};
+
+struct mustach_itf2 bench_itf2 = {
+    .enter = enter2,
+    .next = next,
+    .leave = leave,
+    .get = get2,
+};
+
+struct mustach_itf2 bench_itf2_child = {
+    .enter = enter2,
+    .next = next,
+    .leave = leave,
+    .get = get2,
+    .get_child = get_child,
+    .enter_child = enter_child,
+};
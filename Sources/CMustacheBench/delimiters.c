@@ -0,0 +1,82 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define ROWS 100000
+
+/*
+ * separators switched back and forth in the body of a large loop: the
+ * changes are resolved when compiling, so neither time nor stack grow
+ * with the iterations
+ */
+static const char switches[] =
+    "{{#rows}}"
+    "{{=<% %>=}}<%id%> "
+    "<%={| |}=%>{|name|} "
+    "{|=[[ ]]=|}[[price]] "
+    "[[={{ }}=]]{{id}}\n"
+    "{{/rows}}";
+
+static struct bench_value *data(char (*ids)[16])
+{
+    struct bench_value *root, *rows, *row;
+    size_t i;
+
+    rows = bench_array(ROWS);
+    for (i = 0 ; i < ROWS ; i++) {
+        snprintf(ids[i], sizeof *ids, "%zu", i);
+        row = bench_object(3);
+        bench_set(row, 0, "id", bench_string(ids[i]));
+        bench_set(row, 1, "name", bench_string("A fine product"));
+        bench_set(row, 2, "price", bench_string("12.50"));
+        bench_set(rows, i, NULL, row);
+    }
+    root = bench_object(1);
+    bench_set(root, 0, "rows", rows);
+    return root;
+}
+
+void bench_delimiters(void)
+{
+    static char ids[ROWS][16];
+    struct bench_value *root = data(ids);
+    struct bench_context context;
+    struct mustach_program *program;
+    size_t i, count = 10;
+    double t;
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(fmustach(switches, &bench_itf, &context, bench_null()), "fmustach");
+    }
+    bench_report("fmustach 100000 rows x 4 switches", bench_now() - t, count);
+
+    bench_check(mustach_compile(switches, strlen(switches), &program), "mustach_compile");
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2(program, &bench_itf2, &context, NULL, bench_null()), "mustach_exec2");
+    }
+    bench_report("mustach_exec2 100000 rows x 4 switches", bench_now() - t, count);
+    mustach_program_free(program);
+
+    bench_free(root);
+}
@@ -0,0 +1,94 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define ROWS 1000
+
+/* each row reaches deeply nested values through dotted names */
+static const char report[] =
+    "{{#rows}}"
+    "{{customer.address.city.name}} {{customer.address.city.zip}} "
+    "{{#customer.address.city}}{{name}}{{/customer.address.city}} "
+    "{{order.lines.first.product.label}}\n"
+    "{{/rows}}";
+
+static struct bench_value *chain(const char **names, size_t count, struct bench_value *leaf)
+{
+    struct bench_value *value;
+
+    while (count--) {
+        value = bench_object(1);
+        bench_set(value, 0, names[count], leaf);
+        leaf = value;
+    }
+    return leaf;
+}
+
+static struct bench_value *data(void)
+{
+    static const char *address[] = { "address" };
+    static const char *order[] = { "lines", "first", "product" };
+    struct bench_value *root, *rows, *row, *city, *label;
+    size_t i;
+
+    rows = bench_array(ROWS);
+    for (i = 0 ; i < ROWS ; i++) {
+        city = bench_object(2);
+        bench_set(city, 0, "name", bench_string("Rennes"));
+        bench_set(city, 1, "zip", bench_string("35000"));
+        label = bench_object(1);
+        bench_set(label, 0, "label", bench_string("A fine product"));
+        row = bench_object(2);
+        bench_set(row, 0, "customer", chain(address, 1, chain((const char*[]){ "city" }, 1, city)));
+        bench_set(row, 1, "order", chain(order, 3, label));
+        bench_set(rows, i, NULL, row);
+    }
+    root = bench_object(1);
+    bench_set(root, 0, "rows", rows);
+    return root;
+}
+
+void bench_dotted(void)
+{
+    struct bench_value *root = data();
+    struct bench_context context;
+    struct mustach_program *program;
+    size_t i, count = 500;
+    double t;
+
+    bench_check(mustach_compile(report, strlen(report), &program), "mustach_compile");
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2(program, &bench_itf2, &context, NULL, bench_null()), "mustach_exec2");
+    }
+    bench_report("dotted names split by the provider", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2(program, &bench_itf2_child, &context, NULL, bench_null()), "mustach_exec2");
+    }
+    bench_report("dotted names walked by the engine", bench_now() - t, count);
+
+    mustach_program_free(program);
+    bench_free(root);
+}
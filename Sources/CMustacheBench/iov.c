@@ -0,0 +1,132 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define BLOCKS 50
+
+/* a mostly static page: big blocks of markup around a few values */
+static const char block[] =
+    "<div class=\"card\">\n"
+    "  <div class=\"card-header\"><h3 class=\"card-title\">Static heading of the card</h3></div>\n"
+    "  <div class=\"card-body\">\n"
+    "    <p>Some static paragraph of text, long enough to be a typical part of a page.</p>\n"
+    "    <p>Another static paragraph describing the content, as written in the template.</p>\n"
+    "    <ul>\n"
+    "      <li><a href=\"/first\">The first static link of the card with its title</a></li>\n"
+    "      <li><a href=\"/second\">The second static link of the card with its title</a></li>\n"
+    "      <li><a href=\"/third\">The third static link of the card with its title</a></li>\n"
+    "      <li><a href=\"/fourth\">The fourth static link of the card with its title</a></li>\n"
+    "      <li><a href=\"/fifth\">The fifth static link of the card with its title</a></li>\n"
+    "      <li><a href=\"/sixth\">The sixth static link of the card with its title</a></li>\n"
+    "      <li><a href=\"/seventh\">The seventh static link of the card with its title</a></li>\n"
+    "      <li><a href=\"/eighth\">The eighth static link of the card with its title</a></li>\n"
+    "    </ul>\n"
+    "    <p>A last static paragraph closing the card, with its own long sentence of text.</p>\n"
+    "    <p class=\"user\">{{user}}</p>\n"
+    "  </div>\n"
+    "</div>\n";
+
+void bench_iov(void)
+{
+    struct bench_value *root;
+    struct bench_context context;
+    struct mustach_program *program;
+    struct mustach_iov *iov;
+    char *template, *result;
+    size_t i, size, count = 5000;
+    int fd;
+    FILE *file;
+    double t;
+
+    root = bench_object(1);
+    bench_set(root, 0, "user", bench_string("John <john@example.com>"));
+    template = malloc(BLOCKS * (sizeof block - 1));
+    if (template == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for (i = 0 ; i < BLOCKS ; i++)
+        memcpy(&template[i * (sizeof block - 1)], block, sizeof block - 1);
+    bench_check(mustach_compile(template, BLOCKS * (sizeof block - 1), &program), "mustach_compile");
+    fd = open("/dev/null", O_WRONLY);
+    if (fd < 0) {
+        perror("/dev/null");
+        exit(1);
+    }
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2_mem(program, &bench_itf2, &context, NULL, &result, &size), "mustach_exec2_mem");
+        free(result);
+    }
+    bench_report("exec2_mem", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2_iov(program, &bench_itf2, &context, NULL, &iov), "mustach_exec2_iov");
+        mustach_iov_free(iov);
+    }
+    bench_report("exec2_iov", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2_mem(program, &bench_itf2, &context, NULL, &result, &size), "mustach_exec2_mem");
+        bench_check(write(fd, result, size) == (ssize_t)size ? 0 : -1, "write");
+        free(result);
+    }
+    bench_report("exec2_mem and write", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2_writev(program, &bench_itf2, &context, NULL, fd), "mustach_exec2_writev");
+    }
+    bench_report("exec2_writev", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        file = fdopen(dup(fd), "w");
+        if (file == NULL) {
+            perror("fdopen");
+            exit(1);
+        }
+        bench_check(mustach_exec2(program, &bench_itf2, &context, NULL, file), "mustach_exec2");
+        fclose(file);
+    }
+    bench_report("exec2 in fdopen stream", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2_fd(program, &bench_itf2, &context, NULL, fd), "mustach_exec2_fd");
+    }
+    bench_report("exec2_fd", bench_now() - t, count);
+
+    close(fd);
+    mustach_program_free(program);
+    free(template);
+    bench_free(root);
+}
@@ -0,0 +1,96 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define ROWS 5000
+
+/* a listing page: the body of the section is iterated for each row */
+static const char listing[] =
+    "<table>\n"
+    "{{#rows}}  <tr class=\"row\">\n"
+    "    <td class=\"id\">{{id}}</td>\n"
+    "    <td class=\"name\"><a href=\"/items/{{id}}\">{{name}}</a></td>\n"
+    "    <td class=\"price\">{{price}} EUR</td>\n"
+    "  </tr>\n{{/rows}}"
+    "</table>\n";
+
+static struct bench_value *data(char (*ids)[16])
+{
+    struct bench_value *root, *rows, *row;
+    size_t i;
+
+    rows = bench_array(ROWS);
+    for (i = 0 ; i < ROWS ; i++) {
+        snprintf(ids[i], sizeof *ids, "%zu", i);
+        row = bench_object(3);
+        bench_set(row, 0, "id", bench_string(ids[i]));
+        bench_set(row, 1, "name", bench_string("A fine product"));
+        bench_set(row, 2, "price", bench_string("12.50"));
+        bench_set(rows, i, NULL, row);
+    }
+    root = bench_object(1);
+    bench_set(root, 0, "rows", rows);
+    return root;
+}
+
+void bench_loop(void)
+{
+    static char ids[ROWS][16];
+    struct bench_value *root = data(ids);
+    struct bench_context context;
+    struct mustach_program *program;
+    size_t i, count = 200;
+    double t;
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(fmustach(listing, &bench_itf, &context, bench_null()), "fmustach");
+    }
+    bench_report("fmustach 5000 rows", bench_now() - t, count);
+
+    bench_check(mustach_compile(listing, strlen(listing), &program), "mustach_compile");
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec(program, &bench_itf, &context, bench_null()), "mustach_exec");
+    }
+    bench_report("mustach_exec 5000 rows", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        struct mustach_render *render;
+        char buffer[16384];
+        size_t written;
+        int rc;
+
+        bench_context_init(&context, root);
+        bench_check(mustach_render_create(&render, program, &bench_itf2, &context, NULL), "mustach_render_create");
+        do {
+            rc = mustach_step(render, buffer, sizeof buffer, &written);
+        } while (rc > 0);
+        bench_check(rc, "mustach_step");
+        mustach_render_free(render);
+    }
+    bench_report("mustach_step 5000 rows by 16 KiB", bench_now() - t, count);
+    mustach_program_free(program);
+
+    bench_free(root);
+}
@@ -0,0 +1,95 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+static const struct {
+    const char *name;
+    void (*run)(void);
+} benches[] = {
+    { "compile", bench_compile },
+    { "interface", bench_interface },
+    { "loop", bench_loop },
+    { "skip", bench_skip },
+    { "scan", bench_scan },
+    { "dotted", bench_dotted },
+    { "partials", bench_partials },
+    { "delimiters", bench_delimiters },
+    { "nesting", bench_nesting },
+    { "stream", bench_stream },
+    { "archive", bench_archive },
+    { "memory", bench_memory },
+    { "iov", bench_iov },
+    { "buffer", bench_buffer },
+};
+
+double bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+FILE *bench_null(void)
+{
+    static FILE *null;
+
+    if (null == NULL) {
+        null = fopen("/dev/null", "w");
+        if (null == NULL) {
+            perror("/dev/null");
+            exit(1);
+        }
+    }
+    return null;
+}
+
+void bench_report(const char *label, double seconds, size_t count)
+{
+    printf("  %-32s %10.1f ns/op %12zu ops\n", label, seconds * 1e9 / (double)count, count);
+}
+
+void bench_check(int rc, const char *what)
+{
+    if (rc < 0) {
+        fprintf(stderr, "%s failed: %d\n", what, rc);
+        exit(1);
+    }
+}
+
+int main(int ac, char **av)
+{
+    size_t i;
+    int a, found;
+
+    for (i = 0 ; i < sizeof benches / sizeof *benches ; i++) {
+        found = ac < 2;
+        for (a = 1 ; !found && a < ac ; a++)
+            found = !strcmp(av[a], benches[i].name);
+        if (found) {
+            printf("%s\n", benches[i].name);
+            benches[i].run();
+        }
+    }
+    return 0;
+}
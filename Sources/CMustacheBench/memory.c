@@ -0,0 +1,105 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define ROWS 1000
+
+/* a listing rendered in memory, about 40 KB */
+static const char listing[] =
+    "<table>\n"
+    "{{#rows}}<tr><td>{{id}}</td><td>{{name}}</td></tr>\n{{/rows}}"
+    "</table>\n";
+
+static struct bench_value *data(void)
+{
+    struct bench_value *root, *rows, *row;
+    size_t i;
+
+    rows = bench_array(ROWS);
+    for (i = 0 ; i < ROWS ; i++) {
+        row = bench_object(2);
+        bench_set(row, 0, "id", bench_string("12345"));
+        bench_set(row, 1, "name", bench_string("a name & a <tag>"));
+        bench_set(rows, i, NULL, row);
+    }
+    root = bench_object(1);
+    bench_set(root, 0, "rows", rows);
+    return root;
+}
+
+void bench_memory(void)
+{
+    struct bench_value *root = data();
+    struct bench_context context;
+    struct mustach_program *program;
+    struct mustach_options options = { NULL };
+    char *result;
+    size_t i, size, hint, estimate, count = 2000;
+    FILE *file;
+    double t;
+
+    bench_check(mustach_compile(listing, sizeof listing - 1, &program), "mustach_compile");
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        file = open_memstream(&result, &size);
+        if (file == NULL) {
+            perror("open_memstream");
+            exit(1);
+        }
+        bench_check(mustach_exec2(program, &bench_itf2, &context, NULL, file), "mustach_exec2");
+        fclose(file);
+        free(result);
+    }
+    bench_report("exec2 in open_memstream", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2_mem(program, &bench_itf2, &context, NULL, &result, &size), "mustach_exec2_mem");
+        free(result);
+    }
+    bench_report("exec2_mem", bench_now() - t, count);
+
+    hint = size + 1;
+    options.capacity = hint;
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2_mem(program, &bench_itf2, &context, &options, &result, &size), "mustach_exec2_mem");
+        free(result);
+    }
+    bench_report("exec2_mem with capacity hint", bench_now() - t, count);
+
+    estimate = 0;
+    options.capacity = 0;
+    options.estimate = &estimate;
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2_mem(program, &bench_itf2, &context, &options, &result, &size), "mustach_exec2_mem");
+        free(result);
+    }
+    bench_report("exec2_mem with running estimate", bench_now() - t, count);
+
+    mustach_program_free(program);
+    bench_free(root);
+}
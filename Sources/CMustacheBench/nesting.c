@@ -0,0 +1,66 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define LEVELS 200
+
+/* a recursive tree menu: each level includes the partial again */
+static const char page[] = "<nav>{{>menu}}</nav>\n";
+static const char menu[] = "<ul>{{#children}}<li>{{name}}{{>menu}}</li>{{/children}}</ul>";
+
+static struct bench_value *data(void)
+{
+    struct bench_value *node, *children;
+    int i;
+
+    node = bench_object(2);
+    bench_set(node, 0, "name", bench_string("leaf"));
+    bench_set(node, 1, "children", bench_array(0));
+    for (i = 0 ; i < LEVELS ; i++) {
+        children = bench_array(1);
+        bench_set(children, 0, NULL, node);
+        node = bench_object(2);
+        bench_set(node, 0, "name", bench_string("entry"));
+        bench_set(node, 1, "children", children);
+    }
+    bench_set(node, 0, "menu", bench_string(menu));
+    return node;
+}
+
+void bench_nesting(void)
+{
+    struct bench_value *root = data();
+    struct bench_context context;
+    struct mustach_program *program;
+    struct mustach_options options = { .max_depth = LEVELS + 1 };
+    size_t i, count = 2000;
+    double t;
+
+    bench_check(mustach_compile(page, strlen(page), &program), "mustach_compile");
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2(program, &bench_itf2, &context, &options, bench_null()), "mustach_exec2");
+    }
+    bench_report("mustach_exec2 200 nested partials", bench_now() - t, count);
+    mustach_program_free(program);
+
+    bench_free(root);
+}
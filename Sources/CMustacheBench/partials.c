@@ -0,0 +1,104 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define ROWS 1000
+
+/* a partial included for each row of a section */
+static const char page[] = "<table>\n{{#rows}}{{>row}}{{/rows}}</table>\n";
+static const char row[] = "  <tr><td>{{id}}</td><td>{{name}}</td></tr>\n";
+
+static struct bench_value *data(char (*ids)[16])
+{
+    struct bench_value *root, *rows, *item;
+    size_t i;
+
+    rows = bench_array(ROWS);
+    for (i = 0 ; i < ROWS ; i++) {
+        snprintf(ids[i], sizeof *ids, "%zu", i);
+        item = bench_object(2);
+        bench_set(item, 0, "id", bench_string(ids[i]));
+        bench_set(item, 1, "name", bench_string("A fine product"));
+        bench_set(rows, i, NULL, item);
+    }
+    root = bench_object(2);
+    bench_set(root, 0, "rows", rows);
+    bench_set(root, 1, "row", bench_string(row));
+    return root;
+}
+
+static int resolve(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    (void)closure;
+    if (length != 3 || memcmp(name, "row", 3))
+        return 0;
+    sbuf->value = row;
+    sbuf->length = sizeof row - 1;
+    return 1;
+}
+
+/* gives the partial 'row' to the renderings, it only depends on its name */
+static int partial(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    resolve(closure, name, length, sbuf);
+    return MUSTACH_OK;
+}
+
+void bench_partials(void)
+{
+    static char ids[ROWS][16];
+    struct bench_value *root = data(ids);
+    struct bench_context context;
+    struct mustach_program *program;
+    struct mustach_itf2 itf = bench_itf2;
+    struct mustach_options options = { NULL };
+    size_t i, count = 200;
+    double t;
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(fmustach(page, &bench_itf, &context, bench_null()), "fmustach");
+    }
+    bench_report("fmustach 1000 partials", bench_now() - t, count);
+
+    bench_check(mustach_compile(page, strlen(page), &program), "mustach_compile");
+    bench_check(mustach_partials_create(&options.partials), "mustach_partials_create");
+    itf.partial = partial;
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2(program, &itf, &context, &options, bench_null()), "mustach_exec2");
+    }
+    bench_report("mustach_exec2 kept partials", bench_now() - t, count);
+    mustach_partials_free(options.partials);
+    mustach_program_free(program);
+
+    bench_check(mustach_compile_inline(page, strlen(page), resolve, NULL, &program), "mustach_compile_inline");
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2(program, &bench_itf2, &context, NULL, bench_null()), "mustach_exec2");
+    }
+    bench_report("mustach_exec2 inlined partials", bench_now() - t, count);
+    mustach_program_free(program);
+
+    bench_free(root);
+}
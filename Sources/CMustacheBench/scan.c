@@ -0,0 +1,90 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define SIZE (8 << 20)
+
+/* literal heavy html: a tag every few kilobytes */
+static char *html(const char *op, const char *cl, size_t *length)
+{
+    static const char line[] =
+        "<div class=\"card\"><span class=\"label\">Lorem ipsum</span> dolor sit amet, "
+        "consectetur adipiscing elit {curly} but not a tag.</div>\n";
+    char *text = malloc(SIZE + 256), *p = text;
+    size_t n = 0;
+
+    if (text == NULL)
+        abort();
+    if (strcmp(op, "{{"))
+        p += sprintf(p, "{{=%s %s=}}", op, cl);
+    while ((size_t)(p - text) < SIZE) {
+        memcpy(p, line, sizeof line - 1);
+        p += sizeof line - 1;
+        if (++n % 32 == 0)
+            p += sprintf(p, "%svalue%s", op, cl);
+    }
+    *p = 0;
+    *length = (size_t)(p - text);
+    return text;
+}
+
+static void report(const char *label, double seconds, size_t bytes)
+{
+    printf("  %-32s %10.2f GB/s\n", label, (double)bytes / seconds * 1e-9);
+}
+
+static void run(const char *op, const char *cl)
+{
+    struct mustach_program *program;
+    char *text, label[64];
+    const char *p, *end;
+    size_t length, i, count = 20, found = 0;
+    double t;
+
+    text = html(op, cl, &length);
+    end = text + length;
+    t = bench_now();
+    for (i = 0 ; i < count ; i++)
+        for (p = text ; (p = memmem(p, (size_t)(end - p), op, strlen(op))) != NULL ; p++)
+            found++;
+    snprintf(label, sizeof label, "memmem '%s'", op);
+    report(label, bench_now() - t, count * length);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_check(mustach_compile(text, length, &program), "mustach_compile");
+        mustach_program_free(program);
+    }
+    snprintf(label, sizeof label, "mustach_compile '%s %s'", op, cl);
+    report(label, bench_now() - t, count * length);
+    free(text);
+    if (!found)
+        abort();
+}
+
+void bench_scan(void)
+{
+    run("{{", "}}");
+    run("<%", "%>");
+    run("[[[", "]]]");
+}
@@ -0,0 +1,74 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define BLOCKS 1000
+
+/* a conditional panel made of many nested sections, values and partials */
+static const char block[] =
+    "<div class=\"panel\">{{#items}}<p>{{label}}: {{value}}</p>{{/items}}"
+    "{{^empty}}<i>{{note}}</i>{{/empty}}{{>panel-footer}}</div>\n";
+
+static char *panel(const char *name, const char *inverted)
+{
+    size_t i, len = strlen(block);
+    char *text = malloc(64 + BLOCKS * len), *p;
+
+    if (text == NULL)
+        abort();
+    p = text + sprintf(text, "{{%s%s}}", inverted, name);
+    for (i = 0 ; i < BLOCKS ; i++, p += len)
+        memcpy(p, block, len);
+    sprintf(p, "{{/%s}}", name);
+    return text;
+}
+
+static void run(const char *label, const char *template, struct bench_value *root)
+{
+    struct bench_context context;
+    struct mustach_program *program;
+    size_t i, count = 20000;
+    double t;
+
+    bench_check(mustach_compile(template, strlen(template), &program), "mustach_compile");
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_context_init(&context, root);
+        bench_check(mustach_exec(program, &bench_itf, &context, bench_null()), "mustach_exec");
+    }
+    bench_report(label, bench_now() - t, count);
+    mustach_program_free(program);
+}
+
+void bench_skip(void)
+{
+    struct bench_value *root;
+    char *section = panel("admin", "#");
+    char *inverted = panel("user", "^");
+
+    root = bench_object(2);
+    bench_set(root, 0, "admin", bench_string("false"));
+    bench_set(root, 1, "user", bench_string("Ada"));
+    run("false #section of 1000 blocks", section, root);
+    run("truthy ^section of 1000 blocks", inverted, root);
+    bench_free(root);
+    free(section);
+    free(inverted);
+}
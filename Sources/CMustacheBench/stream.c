@@ -0,0 +1,108 @@
+/*
+ Benchmarks of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+#define SECTIONS 50000
+
+/* a generated report: many small top level sections, one after the other */
+static const char section[] =
+    "<h2>{{title}}</h2>\n"
+    "{{#rows}}<p>{{id}}: {{name}}</p>\n{{/rows}}";
+
+/* reads the template from memory as a file would be */
+struct reader {
+    const char *template;
+    size_t length;
+    size_t offset;
+};
+
+static int read_template(void *closure, char *buffer, size_t size, size_t *count)
+{
+    struct reader *reader = closure;
+    size_t n = reader->length - reader->offset;
+
+    if (n > size)
+        n = size;
+    memcpy(buffer, &reader->template[reader->offset], n);
+    reader->offset += n;
+    *count = n;
+    return MUSTACH_OK;
+}
+
+static struct bench_value *data(void)
+{
+    struct bench_value *root, *rows, *row;
+
+    rows = bench_array(2);
+    row = bench_object(2);
+    bench_set(row, 0, "id", bench_string("1"));
+    bench_set(row, 1, "name", bench_string("first"));
+    bench_set(rows, 0, NULL, row);
+    row = bench_object(2);
+    bench_set(row, 0, "id", bench_string("2"));
+    bench_set(row, 1, "name", bench_string("second"));
+    bench_set(rows, 1, NULL, row);
+    root = bench_object(2);
+    bench_set(root, 0, "title", bench_string("Report"));
+    bench_set(root, 1, "rows", rows);
+    return root;
+}
+
+void bench_stream(void)
+{
+    struct bench_value *root = data();
+    struct bench_context context;
+    struct reader reader;
+    struct mustach_program *program;
+    char *template;
+    size_t i, length, count = 10;
+    double t;
+
+    length = SECTIONS * (sizeof section - 1);
+    template = malloc(length);
+    if (template == NULL) {
+        perror("malloc");
+        exit(1);
+    }
+    for (i = 0 ; i < SECTIONS ; i++)
+        memcpy(&template[i * (sizeof section - 1)], section, sizeof section - 1);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        bench_check(mustach_compile(template, length, &program), "mustach_compile");
+        bench_context_init(&context, root);
+        bench_check(mustach_exec2(program, &bench_itf2, &context, NULL, bench_null()), "mustach_exec2");
+        mustach_program_free(program);
+    }
+    bench_report("compile and exec2 whole template", bench_now() - t, count);
+
+    t = bench_now();
+    for (i = 0 ; i < count ; i++) {
+        reader.template = template;
+        reader.length = length;
+        reader.offset = 0;
+        bench_context_init(&context, root);
+        bench_check(mustach_stream(read_template, &reader, &bench_itf2, &context, NULL, bench_null()), "mustach_stream");
+    }
+    bench_report("mustach_stream 64 KiB chunks", bench_now() - t, count);
+
+    free(template);
+    bench_free(root);
+}
@@ -0,0 +1,229 @@
+/*
+ Offline compiler of mustache templates to archives.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+/*
+ * CMustacheCompiler [-i] -o ARCHIVE DIRECTORY
+ *
+ * Compiles the files *.mustache of DIRECTORY and of its subdirectories
+ * to the ARCHIVE that mustach_archive_open loads. Each program is named
+ * by the path of its file relative to DIRECTORY, without the extension:
+ * "mail/welcome.mustache" becomes "mail/welcome".
+ *
+ * With -i, the partials naming templates of DIRECTORY are inlined.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "mustach.h"
+
+#define EXTENSION ".mustache"
+
+struct templates {
+    const char *root;     /* the directory of the templates */
+    int inline_partials;  /* if set, inlines the partials of the directory */
+    unsigned count;       /* count of compiled programs */
+    unsigned acount;      /* allocated count */
+    char **names;
+    struct mustach_program **programs;
+};
+
+static void *xrealloc(void *pointer, size_t size)
+{
+    pointer = realloc(pointer, size);
+    if (pointer == NULL) {
+        perror("realloc");
+        exit(1);
+    }
+    return pointer;
+}
+
+/* reads the whole file of 'path', NULL if it can't be read */
+static char *load(const char *path, size_t *length)
+{
+    FILE *file;
+    char *text;
+    size_t size, n;
+
+    file = fopen(path, "rb");
+    if (file == NULL)
+        return NULL;
+    text = NULL;
+    size = *length = 0;
+    do {
+        if (size - *length < 4096)
+            text = xrealloc(text, size = 2 * size + 4096);
+        n = fread(&text[*length], 1, size - *length, file);
+        *length += n;
+    } while (n);
+    if (ferror(file)) {
+        free(text);
+        text = NULL;
+    }
+    fclose(file);
+    return text;
+}
+
+/* gives to mustach_compile_inline the text of the template 'name' of the directory */
+static int partial(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    struct templates *templates = closure;
+    size_t size;
+    char *path;
+
+    if ((length && name[0] == '/') || memmem(name, length, "..", 2) != NULL)
+        return 0;
+    path = xrealloc(NULL, strlen(templates->root) + length + sizeof EXTENSION + 1);
+    sprintf(path, "%s/%.*s" EXTENSION, templates->root, (int)length, name);
+    sbuf->value = load(path, &size);
+    free(path);
+    if (sbuf->value == NULL)
+        return 0;
+    sbuf->length = size;
+    sbuf->freecb = free;
+    return 1;
+}
+
+static void compile(struct templates *templates, const char *path, const char *name)
+{
+    struct mustach_program *program;
+    size_t length;
+    char *text;
+    int rc;
+
+    text = load(path, &length);
+    if (text == NULL) {
+        perror(path);
+        exit(1);
+    }
+    if (templates->inline_partials)
+        rc = mustach_compile_inline(text, length, partial, templates, &program);
+    else
+        rc = mustach_compile(text, length, &program);
+    free(text);
+    if (rc < 0) {
+        fprintf(stderr, "%s: compilation failed: %d\n", path, rc);
+        exit(1);
+    }
+    if (templates->count == templates->acount) {
+        templates->acount = 2 * templates->acount + 64;
+        templates->names = xrealloc(templates->names, templates->acount * sizeof *templates->names);
+        templates->programs = xrealloc(templates->programs, templates->acount * sizeof *templates->programs);
+    }
+    templates->names[templates->count] = strdup(name);
+    templates->programs[templates->count++] = program;
+}
+
+/* compiles the templates of the directory 'prefix' relative to the root */
+static void scan(struct templates *templates, const char *prefix)
+{
+    struct dirent *ent;
+    struct stat st;
+    DIR *dir;
+    char *path, *name;
+    size_t length;
+
+    path = xrealloc(NULL, strlen(templates->root) + strlen(prefix) + 2);
+    sprintf(path, "%s%s%s", templates->root, *prefix ? "/" : "", prefix);
+    dir = opendir(path);
+    if (dir == NULL) {
+        perror(path);
+        exit(1);
+    }
+    free(path);
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] == '.')
+            continue;
+        name = xrealloc(NULL, strlen(prefix) + strlen(ent->d_name) + 2);
+        sprintf(name, "%s%s%s", prefix, *prefix ? "/" : "", ent->d_name);
+        path = xrealloc(NULL, strlen(templates->root) + strlen(name) + 2);
+        sprintf(path, "%s/%s", templates->root, name);
+        if (stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+            scan(templates, name);
+        else {
+            length = strlen(name);
+            if (length > strlen(EXTENSION) && !strcmp(&name[length - strlen(EXTENSION)], EXTENSION)) {
+                name[length - strlen(EXTENSION)] = 0;
+                compile(templates, path, name);
+            }
+        }
+        free(path);
+        free(name);
+    }
+    closedir(dir);
+}
+
+static void usage(const char *program)
+{
+    fprintf(stderr, "usage: %s [-i] -o ARCHIVE DIRECTORY\n", program);
+    exit(2);
+}
+
+int main(int ac, char **av)
+{
+    struct templates templates;
+    const char *output;
+    FILE *file;
+    unsigned i;
+    int opt, rc;
+
+    memset(&templates, 0, sizeof templates);
+    output = NULL;
+    while ((opt = getopt(ac, av, "io:")) != -1) {
+        switch (opt) {
+        case 'i':
+            templates.inline_partials = 1;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        default:
+            usage(av[0]);
+        }
+    }
+    if (output == NULL || optind != ac - 1)
+        usage(av[0]);
+    templates.root = av[optind];
+    scan(&templates, "");
+
+    file = fopen(output, "wb");
+    if (file == NULL) {
+        perror(output);
+        return 1;
+    }
+    rc = mustach_archive_write(file, (const char *const*)templates.names,
+                               (const struct mustach_program *const*)templates.programs, templates.count);
+    if (fclose(file) != 0 && rc == 0)
+        rc = MUSTACH_ERROR_SYSTEM;
+    if (rc < 0) {
+        fprintf(stderr, "%s: writing failed: %d\n", output, rc);
+        remove(output);
+        return 1;
+    }
+    for (i = 0 ; i < templates.count ; i++) {
+        free(templates.names[i]);
+        mustach_program_free(templates.programs[i]);
+    }
+    free(templates.names);
+    free(templates.programs);
+    return 0;
+}
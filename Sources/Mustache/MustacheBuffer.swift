@@ -0,0 +1,19 @@
+/// A reusable output of renderings, see `MustacheTemplate.render(data:into:)`.
+///
+/// Its memory is kept from a rendering to the next: a buffer kept per
+/// thread or per connection renders without allocating once it has the
+/// size of the pages. It must not be used by concurrent renderings.
+public final class MustacheBuffer {
+    /// The bytes of the last rendering
+    public internal(set) var bytes: [UInt8]
+
+    public init(capacity: Int = 0) {
+        self.bytes = []
+        self.bytes.reserveCapacity(capacity)
+    }
+
+    /// The last rendering as a string
+    public var string: String {
+        return String(decoding: self.bytes, as: UTF8.self)
+    }
+}
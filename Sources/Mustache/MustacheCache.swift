@@ -0,0 +1,166 @@
+import Foundation
+
+/// A cache of compiled templates, keyed by name or by source, bounded in
+/// memory and evicting the least recently used templates first.
+///
+/// The cache is thread safe.
+public final class MustacheCache {
+    enum Key: Hashable {
+        case name(String)
+        case source(String)
+
+        /// Size in bytes of the key, a source being kept whole
+        var size: Int {
+            switch self {
+            case .name(let text), .source(let text):
+                return MemoryLayout<String>.stride + text.utf8.count
+            }
+        }
+    }
+
+    final class Entry {
+        let key: Key
+        let template: MustacheTemplate
+        /// Size in bytes of the template and of its key
+        let size: Int
+        weak var previous: Entry?
+        var next: Entry?
+
+        init(key: Key, template: MustacheTemplate) {
+            self.key = key
+            self.template = template
+            self.size = template.size + key.size
+        }
+    }
+
+    /// Maximum size in bytes of the cached templates, their names and
+    /// sources included
+    public let capacity: Int
+
+    private let lock = NSLock()
+    private var entries: [Key: Entry] = [:]
+    /// Most recently used entry, its `next` are less recently used
+    private var head: Entry?
+    /// Least recently used entry, the next to be evicted
+    private var tail: Entry?
+    private var total = 0
+
+    public init(capacity: Int = 16 * 1024 * 1024) {
+        self.capacity = capacity
+    }
+
+    /// Size in bytes of the cached templates, their names and sources included
+    public var size: Int {
+        self.lock.lock()
+        defer { self.lock.unlock() }
+        return self.total
+    }
+
+    /// Count of the cached templates
+    public var count: Int {
+        self.lock.lock()
+        defer { self.lock.unlock() }
+        return self.entries.count
+    }
+
+    /// Returns the template `name`, compiling the text returned by `source` if not cached.
+    public func template(named name: String, source: () throws -> String) throws -> MustacheTemplate {
+        return try self.template(for: .name(name)) { try MustacheTemplate(try source()) }
+    }
+
+    /// Returns the compiled `source`, compiling it if not cached.
+    public func template(for source: String) throws -> MustacheTemplate {
+        return try self.template(for: .source(source)) { try MustacheTemplate(source) }
+    }
+
+    /// Caches `template` under `name`, replacing any template of that name.
+    public func insert(_ template: MustacheTemplate, named name: String) {
+        self.insert(template, for: .name(name))
+    }
+
+    /// Invalidates the template `name`.
+    public func removeTemplate(named name: String) {
+        self.lock.lock()
+        defer { self.lock.unlock() }
+        if let entry = self.entries.removeValue(forKey: .name(name)) {
+            self.unlink(entry)
+        }
+    }
+
+    /// Invalidates all the templates.
+    public func removeAll() {
+        self.lock.lock()
+        defer { self.lock.unlock() }
+        self.entries.removeAll()
+        self.head = nil
+        self.tail = nil
+        self.total = 0
+    }
+
+    private func template(for key: Key, compile: () throws -> MustacheTemplate) throws -> MustacheTemplate {
+        self.lock.lock()
+        if let entry = self.entries[key] {
+            self.unlink(entry)
+            self.link(entry)
+            self.lock.unlock()
+            return entry.template
+        }
+        self.lock.unlock()
+
+        // compiles without holding the lock
+        let template = try compile()
+        self.insert(template, for: key)
+        return template
+    }
+
+    private func insert(_ template: MustacheTemplate, for key: Key) {
+        let entry = Entry(key: key, template: template)
+        self.lock.lock()
+        defer { self.lock.unlock() }
+        if let old = self.entries.removeValue(forKey: key) {
+            self.unlink(old)
+        }
+        guard entry.size <= self.capacity else {
+            return
+        }
+        while self.total + entry.size > self.capacity, let last = self.tail {
+            self.entries.removeValue(forKey: last.key)
+            self.unlink(last)
+        }
+        self.entries[key] = entry
+        self.link(entry)
+    }
+
+    /// Adds `entry` as the most recently used, the lock must be held
+    private func link(_ entry: Entry) {
+        entry.previous = nil
+        entry.next = self.head
+        self.head?.previous = entry
+        self.head = entry
+        if self.tail == nil {
+            self.tail = entry
+        }
+        self.total += entry.size
+    }
+
+    /// Removes `entry` from the list, the lock must be held
+    private func unlink(_ entry: Entry) {
+        if let previous = entry.previous {
+            previous.next = entry.next
+        } else {
+            self.head = entry.next
+        }
+        if let next = entry.next {
+            next.previous = entry.previous
+        } else {
+            self.tail = entry.previous
+        }
+        entry.previous = nil
+        entry.next = nil
+        self.total -= entry.size
+    }
+}
+
+#if compiler(>=5.5)
+extension MustacheCache: @unchecked Sendable { }
+#endif
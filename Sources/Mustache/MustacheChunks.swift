@@ -0,0 +1,125 @@
+#if compiler(>=5.5) && canImport(_Concurrency)
+import CMustache
+
+/// The rendering of a template as chunks of bytes, see
+/// `MustacheTemplate.chunks(data:size:)`.
+///
+/// The rendering progresses only when a chunk is asked for: it pauses
+/// while the consumer is busy, so its memory is bounded by the size of
+/// the chunks and not by the size of the page. Iterating it again renders
+/// the template again.
+@available(macOS 10.15, *)
+public struct MustacheChunks: AsyncSequence {
+    public typealias Element = [UInt8]
+
+    let template: MustacheTemplate
+    let data: [String: MustacheData]
+    /// The size of the chunks, all full but the last
+    let size: Int
+
+    public func makeAsyncIterator() -> AsyncIterator {
+        return AsyncIterator(rendering: MustacheRendering(template: self.template, data: self.data), size: self.size)
+    }
+
+    public struct AsyncIterator: AsyncIteratorProtocol {
+        let rendering: MustacheRendering
+        let size: Int
+
+        /// Renders the next chunk, nil at the end. The rendering is
+        /// abandoned when the task is cancelled.
+        public mutating func next() async throws -> [UInt8]? {
+            if Task.isCancelled {
+                self.rendering.cancel()
+                throw CancellationError()
+            }
+            return try self.rendering.next(self.size)
+        }
+    }
+}
+
+/// A step-wise rendering by mustach_step, its state is kept by mustach
+/// between the steps
+final class MustacheRendering {
+    let template: MustacheTemplate
+    let context: UnsafeMutablePointer<MustacheContext>
+    let itf: UnsafeMutablePointer<mustach_itf2>
+    let options: UnsafeMutablePointer<mustach_options>
+    var render: OpaquePointer?
+    var done = false
+
+    init(template: MustacheTemplate, data: [String: MustacheData]) {
+        self.template = template
+        self.context = UnsafeMutablePointer<MustacheContext>.allocate(capacity: 1)
+        self.context.initialize(to: MustacheContext(data: data, symbols: template.symbols, partials: template.partials))
+        self.itf = UnsafeMutablePointer<mustach_itf2>.allocate(capacity: 1)
+        self.itf.initialize(to: self.context.pointee.itf)
+        self.options = UnsafeMutablePointer<mustach_options>.allocate(capacity: 1)
+        self.options.initialize(to: template.options)
+    }
+
+    deinit {
+        self.cancel()
+        self.context.pointee.deallocate()
+        self.context.deinitialize(count: 1)
+        self.context.deallocate()
+        self.itf.deallocate()
+        self.options.deallocate()
+    }
+
+    /// Renders at most `size` bytes, nil when the rendering is done
+    func next(_ size: Int) throws -> [UInt8]? {
+        guard !self.done else {
+            return nil
+        }
+        if self.render == nil {
+            // a positive status gives a rendering already complete
+            let status = mustach_render_create(&self.render, self.template.program, self.itf, self.context, self.options)
+            guard status >= MUSTACH_OK else {
+                self.done = true
+                throw MustacheError(status: status)
+            }
+        }
+        var status: Int32 = 1
+        let chunk = [UInt8](unsafeUninitializedCapacity: max(size, 1)) { buffer, count in
+            let bytes = UnsafeMutableRawPointer(buffer.baseAddress!).assumingMemoryBound(to: CChar.self)
+            count = 0
+            while count == 0 && status == 1 {
+                status = mustach_step(self.render, bytes, buffer.count, &count)
+            }
+        }
+        if status != 1 {
+            self.cancel()
+            guard status == 0 else {
+                throw MustacheError(status: status)
+            }
+            if chunk.isEmpty {
+                return nil
+            }
+        }
+        return chunk
+    }
+
+    /// Ends the rendering and releases its state
+    func cancel() {
+        self.done = true
+        mustach_render_free(self.render)
+        self.render = nil
+    }
+}
+
+@available(macOS 10.15, *)
+extension MustacheTemplate {
+    /// Renders as chunks of `size` bytes, produced as they are iterated
+    public func chunks(data: [String: MustacheData], size: Int = 4096) -> MustacheChunks {
+        return MustacheChunks(template: self, data: data, size: max(size, 1))
+    }
+}
+
+@available(macOS 10.15, *)
+extension MustacheRenderer {
+    /// Renders the cached template `name` as chunks of `size` bytes
+    public func chunks(named name: String, data: [String: MustacheData], size: Int = 4096, source: () throws -> String) throws -> MustacheChunks {
+        return try self.cache.template(named: name, source: source).chunks(data: data, size: size)
+    }
+}
+#endif
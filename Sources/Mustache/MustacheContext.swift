@@ -1,16 +1,90 @@
 import CMustache
 
 struct MustacheContext {
-    var stack: [MustacheData]
+    private(set) var stack: [MustacheData]
     var index: Int
+    /// Names of the symbols of the rendered program, indexed by symbol
+    let symbols: [String]
+    /// Symbols resolved in each level of the stack, see `get(symbol:)`
+    var levels: [Level]
+    /// Texts of the partials, the partials not found are taken from the data
+    let partials: [String: String]
+    /// Zero terminated copy of the last value given to mustach
+    var value: UnsafeMutableBufferPointer<CChar>
+    /// Current item of the walk of a dotted name
+    var cursor: MustacheData?
 
-    init(data: [String: MustacheData]) {
-        self.stack = [.dictionary(data)]
-        self.index = 0
+    /// Values of the symbols resolved in a level of the stack, indexed by
+    /// symbol and filled as resolved. The values of an array are the ones
+    /// of its item at `index`, they are dropped when the index changes.
+    struct Level {
+        var index: Int?
+        var values: [MustacheData??]
+
+        init(_ data: MustacheData) {
+            if case .array = data {
+                self.index = -1
+            }
+            self.values = []
+        }
+    }
+
+    init(data: [String: MustacheData], symbols: [String] = [], partials: [String: String] = [:]) {
+        self.init(stack: [.dictionary(data)], index: 0, symbols: symbols, partials: partials)
+    }
+
+    init(stack: [MustacheData], index: Int, symbols: [String], partials: [String: String]) {
+        self.stack = stack
+        self.index = index
+        self.symbols = symbols
+        self.levels = stack.map(Level.init)
+        self.partials = partials
+        self.value = UnsafeMutableBufferPointer(start: nil, count: 0)
+        self.cursor = nil
+    }
+
+    init(data: [String: MustacheData], program: OpaquePointer) {
+        self.init(data: data, symbols: MustacheContext.symbols(of: program))
+    }
+
+    static func symbols(of program: OpaquePointer) -> [String] {
+        return (0..<mustach_program_symbols(program)).map { symbol -> String in
+            var length = 0
+            let name = mustach_program_symbol(program, symbol, &length)
+            return String(decoding: UnsafeRawBufferPointer(start: name, count: length), as: UTF8.self)
+        }
+    }
+
+    func deallocate() {
+        self.value.deallocate()
+    }
+
+    static func name(_ name: UnsafePointer<CChar>, _ length: Int) -> String {
+        return String(decoding: UnsafeRawBufferPointer(start: name, count: length), as: UTF8.self)
+    }
+
+    /// Gives `string` to mustach through `sbuf`, valid until the next call
+    mutating func set(_ string: String, in sbuf: UnsafeMutablePointer<mustach_sbuf>) {
+        var string = string
+        let count = string.withUTF8 { utf8 -> Int in
+            if utf8.count >= self.value.count {
+                self.value.deallocate()
+                self.value = .allocate(capacity: utf8.count + 1)
+            }
+            UnsafeMutableRawBufferPointer(self.value).copyMemory(from: UnsafeRawBufferPointer(utf8))
+            self.value[utf8.count] = 0
+            return utf8.count
+        }
+        sbuf.pointee.value = UnsafePointer(self.value.baseAddress)
+        sbuf.pointee.length = count
     }
 
     func put(name: String) -> String {
-        guard let data = self.get(name: name) else {
+        return self.string(of: self.get(name: name))
+    }
+
+    func string(of data: MustacheData?) -> String {
+        guard let data = data else {
             return ""
         }
         switch data {
@@ -22,8 +96,7 @@ struct MustacheContext {
     }
 
     func get(name: String) -> MustacheData? {
-        var stack = self.stack
-        while let context = stack.popLast() {
+        for context in self.stack.reversed() {
             if let value = self.get(name: name, data: context) {
                 return value
             }
@@ -36,38 +109,7 @@ struct MustacheContext {
 
         var it = name.split(separator: ".").makeIterator()
         while let path = it.next() {
-           var data: [String: MustacheData]
-            switch current {
-            case .dictionary(let value):
-                data = value
-            case .array(let value):
-                let item = value[index]
-                if case .dictionary(let value) = item {
-                    data = value
-                } else {
-                    return nil
-                }
-            default:
-                return nil
-            }
-//            if case .array(let list) = current {
-//                let item = list[index]
-//                guard case .dictionary(let dictData) = item else {
-//                    return nil
-//                }
-//                data = dictData
-//            } else {
-//                if case .dictionary(let dictData) = current {
-//                    data = dictData
-//                } else {
-//                    return nil
-//
-//                }
-//            }
-//            guard case .dictionary(let data) = current else {
-//                return nil
-//            }
-            guard let value = data[String(path)] else {
+            guard let value = self.child(key: String(path), of: current) else {
                 return nil
             }
             current = value
@@ -76,6 +118,71 @@ struct MustacheContext {
         return current
     }
 
+    /// Resolves `symbol` of the program like `get(name:)` but each level of
+    /// the stack resolves it once, the next times it is read by symbol
+    mutating func get(symbol: UInt32) -> MustacheData? {
+        let symbol = Int(symbol)
+        for level in self.levels.indices.reversed() {
+            if let index = self.levels[level].index, index != self.index {
+                self.levels[level].index = self.index
+                self.levels[level].values.removeAll(keepingCapacity: true)
+            }
+            if self.levels[level].values.isEmpty {
+                self.levels[level].values.append(contentsOf: repeatElement(nil, count: self.symbols.count))
+            }
+            let value: MustacheData?
+            if let resolved = self.levels[level].values[symbol] {
+                value = resolved
+            } else {
+                let name = self.symbols[symbol]
+                value = name.utf8.contains(UInt8(ascii: ".")) ? self.get(name: name, data: self.stack[level]) : self.child(key: name, of: self.stack[level])
+                self.levels[level].values[symbol] = .some(value)
+            }
+            if value != nil {
+                return value
+            }
+        }
+        return nil
+    }
+
+    /// Resolves `key`, a name without dots, from the top of the stack
+    func lookup(key: String) -> MustacheData? {
+        for context in self.stack.reversed() {
+            if let value = self.child(key: key, of: context) {
+                return value
+            }
+        }
+        return nil
+    }
+
+    func child(key: String, of data: MustacheData) -> MustacheData? {
+        switch data {
+        case .dictionary(let value):
+            return value[key]
+        case .array(let value):
+            guard self.index < value.count, case .dictionary(let item) = value[self.index] else {
+                return nil
+            }
+            return item[key]
+        default:
+            return nil
+        }
+    }
+
+    /// Walks to the segment `key` of a dotted name, see `get_child` of mustach_itf2
+    mutating func walk(first: Bool, key: String) -> Bool {
+        if first {
+            self.cursor = self.lookup(key: key)
+        } else if let cursor = self.cursor {
+            self.cursor = self.child(key: key, of: cursor)
+        }
+        return self.cursor != nil
+    }
+
+    func key(_ name: UnsafePointer<CChar>, _ length: Int, _ symbol: UInt32) -> String {
+        return symbol == MUSTACH_NO_SYMBOL ? MustacheContext.name(name, length) : self.symbols[Int(symbol)]
+    }
+
     mutating func next() -> Bool {
         guard let data = self.stack.last else {
             fatalError("stack popped too far")
@@ -94,16 +201,22 @@ struct MustacheContext {
     }
 
     mutating func enter(name: String) -> Bool {
-        guard let data = self.get(name: name) else {
+        return self.enter(data: self.get(name: name))
+    }
+
+    mutating func enter(data: MustacheData?) -> Bool {
+        guard let data = data else {
             return false
         }
         switch data {
         case .dictionary, .array:
             self.stack.append(data)
+            self.levels.append(Level(data))
             return true
         case .string(let string):
             if !["false", "0"].contains(string.lowercased()) {
                 self.stack.append(data)
+                self.levels.append(Level(data))
                 return true
             } else {
                 return false
@@ -113,48 +226,114 @@ struct MustacheContext {
 
     mutating func leave() {
         _ = self.stack.popLast()
+        _ = self.levels.popLast()
         self.index = 0
     }
 
-    var itf: mustach_itf {
-        mustach_itf(
+    var itf: mustach_itf2 {
+        mustach_itf2(
             start: nil,
-            put: { closure, name, escape, file in
-                guard let name = name.flatMap(String.init(cString:)) else {
+            put: nil,
+            enter: { closure, name, length in
+                guard let name = name else {
                     return MUSTACH_ERROR_SYSTEM
                 }
-                guard let context = closure?.assumingMemoryBound(to: MustacheContext.self).pointee else {
+                guard let context = closure?.assumingMemoryBound(to: MustacheContext.self) else {
                     return MUSTACH_ERROR_SYSTEM
                 }
-                fputs(context.put(name: name), file)
+                return context.pointee.enter(name: MustacheContext.name(name, length)) ? 1 : 0
+            },
+            next: { closure in
+                guard let context = closure?.assumingMemoryBound(to: MustacheContext.self) else {
+                    return MUSTACH_ERROR_SYSTEM
+                }
+                return context.pointee.next() ? 1 : 0
+            },
+            leave: { closure in
+                guard let context = closure?.assumingMemoryBound(to: MustacheContext.self) else {
+                    return MUSTACH_ERROR_SYSTEM
+                }
+                context.pointee.leave()
                 return MUSTACH_OK
             },
-            enter: { closure, name in
-                guard let name = name.flatMap(String.init(cString:)) else {
+            partial: { closure, name, length, sbuf in
+                guard let name = name, let sbuf = sbuf else {
                     return MUSTACH_ERROR_SYSTEM
                 }
                 guard let context = closure?.assumingMemoryBound(to: MustacheContext.self) else {
                     return MUSTACH_ERROR_SYSTEM
                 }
-                return context.pointee.enter(name: name) ? 1 : 0
+                // the partials taken from the data change with the context, they are not kept
+                let name = MustacheContext.name(name, length)
+                if let text = context.pointee.partials[name] {
+                    context.pointee.set(text, in: sbuf)
+                    return MUSTACH_OK
+                }
+                context.pointee.set(context.pointee.put(name: name), in: sbuf)
+                return 1
             },
-            next: { closure in
+            emit: nil,
+            get: { closure, name, length, sbuf in
+                guard let name = name, let sbuf = sbuf else {
+                    return MUSTACH_ERROR_SYSTEM
+                }
                 guard let context = closure?.assumingMemoryBound(to: MustacheContext.self) else {
                     return MUSTACH_ERROR_SYSTEM
                 }
-                return context.pointee.next() ? 1 : 0
+                let value = context.pointee.put(name: MustacheContext.name(name, length))
+                context.pointee.set(value, in: sbuf)
+                return MUSTACH_OK
             },
-            leave: { closure in
+            stop: nil,
+            enter_by_id: { closure, symbol in
                 guard let context = closure?.assumingMemoryBound(to: MustacheContext.self) else {
                     return MUSTACH_ERROR_SYSTEM
                 }
-                context.pointee.leave()
+                let data = context.pointee.get(symbol: symbol)
+                return context.pointee.enter(data: data) ? 1 : 0
+            },
+            get_by_id: { closure, symbol, sbuf in
+                guard let sbuf = sbuf else {
+                    return MUSTACH_ERROR_SYSTEM
+                }
+                guard let context = closure?.assumingMemoryBound(to: MustacheContext.self) else {
+                    return MUSTACH_ERROR_SYSTEM
+                }
+                let value = context.pointee.string(of: context.pointee.get(symbol: symbol))
+                context.pointee.set(value, in: sbuf)
                 return MUSTACH_OK
             },
-            partial: nil,
-            emit: nil,
-            get: nil,
-            stop: nil
+            get_child: { closure, first, name, length, symbol, sbuf in
+                guard let name = name else {
+                    return MUSTACH_ERROR_SYSTEM
+                }
+                guard let context = closure?.assumingMemoryBound(to: MustacheContext.self) else {
+                    return MUSTACH_ERROR_SYSTEM
+                }
+                let key = context.pointee.key(name, length, symbol)
+                guard context.pointee.walk(first: first != 0, key: key) else {
+                    return 0
+                }
+                if let sbuf = sbuf {
+                    let value = context.pointee.string(of: context.pointee.cursor)
+                    context.pointee.set(value, in: sbuf)
+                }
+                return 1
+            },
+            enter_child: { closure, name, length, symbol in
+                guard let name = name else {
+                    return MUSTACH_ERROR_SYSTEM
+                }
+                guard let context = closure?.assumingMemoryBound(to: MustacheContext.self) else {
+                    return MUSTACH_ERROR_SYSTEM
+                }
+                let key = context.pointee.key(name, length, symbol)
+                guard let cursor = context.pointee.cursor else {
+                    return 0
+                }
+                let data = context.pointee.child(key: key, of: cursor)
+                return context.pointee.enter(data: data) ? 1 : 0
+            }
         )
     }
 }
@@ -0,0 +1,12 @@
+/// An output that only counts the bytes of the renderings
+public struct MustacheCountingOutput: MustacheOutputStream {
+    /// The count of bytes written
+    public private(set) var count: Int = 0
+
+    public init() {
+    }
+
+    public mutating func write(_ bytes: UnsafeRawBufferPointer) {
+        self.count += bytes.count
+    }
+}
@@ -1,7 +1,7 @@
 import CMustache
 import Foundation
 
-public enum MustacheError: Error, CustomStringConvertible {
+public enum MustacheError: Error, Equatable, CustomStringConvertible {
     case system
     case unexpectedEnd
     case emptyTag
@@ -13,6 +13,11 @@ public enum MustacheError: Error, CustomStringConvertible {
     case invalidITF
     case itemNotFound
     case partialNotFound
+    case aborted
+    case badArchive
+    case tooSmall
+    /// A status without case, returned by a callback or by a newer engine
+    case other(Int32)
 
     public var reason: String {
         switch self {
@@ -27,6 +32,10 @@ public enum MustacheError: Error, CustomStringConvertible {
         case .invalidITF: return "invalid itf"
         case .itemNotFound: return "item not found"
         case .partialNotFound: return "partial not found"
+        case .aborted: return "aborted"
+        case .badArchive: return "bad archive"
+        case .tooSmall: return "buffer too small"
+        case .other(let status): return "status \(status)"
         }
     }
 
@@ -34,8 +43,10 @@ public enum MustacheError: Error, CustomStringConvertible {
         return "Mustache error: \(self.reason)"
     }
 
-    init?(status: Int32) {
+    init(status: Int32) {
         switch status {
+        case MUSTACH_ERROR_SYSTEM:
+            self = .system
         case MUSTACH_ERROR_UNEXPECTED_END:
             self = .unexpectedEnd
         case MUSTACH_ERROR_EMPTY_TAG:
@@ -56,8 +67,14 @@ public enum MustacheError: Error, CustomStringConvertible {
             self = .itemNotFound
         case MUSTACH_ERROR_PARTIAL_NOT_FOUND:
             self = .partialNotFound
+        case MUSTACH_ERROR_ABORTED:
+            self = .aborted
+        case MUSTACH_ERROR_BAD_ARCHIVE:
+            self = .badArchive
+        case MUSTACH_ERROR_TOO_SMALL:
+            self = .tooSmall
         default:
-            return nil
+            self = .other(status)
         }
     }
 }
@@ -0,0 +1,66 @@
+import Foundation
+#if canImport(Darwin)
+import Darwin
+private let systemWrite = Darwin.write
+#else
+import Glibc
+private let systemWrite = Glibc.write
+#endif
+
+/// An output writing the renderings in a file handle through a buffer.
+///
+/// The buffer is written when full and by `flush()`, the writes bigger
+/// than the buffer are written directly. The handle is not closed.
+public final class MustacheFileOutput: MustacheOutputStream {
+    public let handle: FileHandle
+    let capacity: Int
+    var buffer: [UInt8]
+
+    public init(handle: FileHandle, capacity: Int = 65536) {
+        self.handle = handle
+        self.capacity = max(capacity, 1)
+        self.buffer = []
+        self.buffer.reserveCapacity(self.capacity)
+    }
+
+    deinit {
+        try? self.flush()
+    }
+
+    public func write(_ bytes: UnsafeRawBufferPointer) throws {
+        if self.buffer.count + bytes.count > self.capacity {
+            try self.flush()
+        }
+        if bytes.count >= self.capacity {
+            try self.send(bytes)
+        } else {
+            self.buffer.append(contentsOf: bytes)
+        }
+    }
+
+    /// Writes the buffered bytes
+    public func flush() throws {
+        guard !self.buffer.isEmpty else {
+            return
+        }
+        defer { self.buffer.removeAll(keepingCapacity: true) }
+        try self.buffer.withUnsafeBytes { bytes in
+            try self.send(bytes)
+        }
+    }
+
+    /// Writes all the `bytes` in the file descriptor of the handle
+    func send(_ bytes: UnsafeRawBufferPointer) throws {
+        var offset = 0
+        while offset < bytes.count {
+            let count = systemWrite(self.handle.fileDescriptor, bytes.baseAddress! + offset, bytes.count - offset)
+            if count < 0 {
+                guard errno == EINTR else {
+                    throw MustacheError.system
+                }
+            } else {
+                offset += count
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+import CMustache
+
+/// A destination of renderings, see `MustacheTemplate.render(data:into:)`.
+///
+/// The output is written by pieces as the rendering produces it, without
+/// intermediate buffer. An error thrown by `write` stops the
+/// rendering and is thrown by it.
+public protocol MustacheOutputStream {
+    /// Writes the next bytes of the output
+    mutating func write(_ bytes: UnsafeRawBufferPointer) throws
+
+    /// Prepares for about `count` more bytes, the expected size of a rendering
+    mutating func reserve(_ count: Int)
+
+    /// Receives the whole output of a rendering of about `count` bytes:
+    /// `render` produces it by pieces, given to the function it is called
+    /// with. By default, `count` bytes are reserved and each piece is
+    /// written. A stream can collect the pieces to take them at once.
+    mutating func write(expecting count: Int, rendering render: (_ write: (UnsafeRawBufferPointer) throws -> Void) throws -> Void) throws
+}
+
+extension MustacheOutputStream {
+    public mutating func reserve(_ count: Int) {
+    }
+
+    public mutating func write(expecting count: Int, rendering render: (_ write: (UnsafeRawBufferPointer) throws -> Void) throws -> Void) throws {
+        self.reserve(count)
+        try render { bytes in try self.write(bytes) }
+    }
+}
+
+extension Array: MustacheOutputStream where Element == UInt8 {
+    public mutating func write(_ bytes: UnsafeRawBufferPointer) {
+        self.append(contentsOf: bytes)
+    }
+
+    public mutating func reserve(_ count: Int) {
+        self.reserveCapacity(self.count + count)
+    }
+}
+
+extension String: MustacheOutputStream {
+    /// Appends `bytes`, a whole UTF-8 text decoded at each call
+    public mutating func write(_ bytes: UnsafeRawBufferPointer) {
+        self += String(decoding: bytes, as: UTF8.self)
+    }
+
+    public mutating func reserve(_ count: Int) {
+        self.reserveCapacity(self.utf8.count + count)
+    }
+
+    /// Collects the pieces of a rendering in bytes and decodes them once
+    public mutating func write(expecting count: Int, rendering render: (_ write: (UnsafeRawBufferPointer) throws -> Void) throws -> Void) throws {
+        var bytes: [UInt8] = []
+        bytes.reserveCapacity(count)
+        try render { piece in bytes.append(contentsOf: piece) }
+        self += String(decoding: bytes, as: UTF8.self)
+    }
+}
+
+extension MustacheBuffer: MustacheOutputStream {
+    public func write(_ bytes: UnsafeRawBufferPointer) {
+        self.bytes.append(contentsOf: bytes)
+    }
+
+    public func reserve(_ count: Int) {
+        self.bytes.reserveCapacity(self.bytes.count + count)
+    }
+}
+
+/// Gives the output of mustach_exec2_write to a `MustacheOutputStream`
+struct MustacheWriter {
+    let write: (UnsafeRawBufferPointer) throws -> Void
+    /// The error thrown by `write`, that stopped the rendering
+    var error: Error?
+
+    static let function: @convention(c) (UnsafeMutableRawPointer?, UnsafePointer<CChar>?, Int) -> Int32 = { writer, buffer, size in
+        guard let writer = writer?.assumingMemoryBound(to: MustacheWriter.self) else {
+            return MUSTACH_ERROR_SYSTEM
+        }
+        do {
+            try writer.pointee.write(UnsafeRawBufferPointer(start: buffer, count: size))
+            return MUSTACH_OK
+        } catch {
+            writer.pointee.error = error
+            return MUSTACH_ERROR_ABORTED
+        }
+    }
+}
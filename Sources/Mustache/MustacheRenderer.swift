@@ -1,23 +1,47 @@
 import CMustache
 
 public struct MustacheRenderer {
-    public init() { }
+    /// Compiled templates rendered by name
+    public let cache: MustacheCache
 
-    public func render(template: String, data: [String: MustacheData]) throws -> String {
-        var result: UnsafeMutablePointer<Int8>?
-        var size = 0
+    public init(cache: MustacheCache = MustacheCache()) {
+        self.cache = cache
+    }
 
-        var context = MustacheContext(data: data)
-        var itf = context.itf
+    public func render(template: String, data: [String: MustacheData]) throws -> String {
+        var template = template
+        return try template.withUTF8 { template in
+            try self.render(template: UnsafeRawBufferPointer(template), data: data)
+        }
+    }
 
-        let status = mustach(template, &itf, &context, &result, &size)
-        guard status == MUSTACH_OK else {
-            throw MustacheError(status: status)!
+    public func render(template: [UInt8], data: [String: MustacheData]) throws -> String {
+        return try template.withUnsafeBytes { template in
+            try self.render(template: template, data: data)
         }
-        let buffer = UnsafeBufferPointer(
-            start: UnsafeRawPointer(result!).assumingMemoryBound(to: UInt8.self),
-            count: size
-        )
-        return String(decoding: buffer, as: UTF8.self)
+    }
+
+    /// Renders the UTF-8 `template` in place: its texts are not copied, only its
+    /// tags are compiled, and it is not required to be zero terminated.
+    public func render(template: UnsafeRawBufferPointer, data: [String: MustacheData]) throws -> String {
+        return try MustacheTemplate(inPlace: template).render(data: data)
+    }
+
+    public func render(template: MustacheTemplate, data: [String: MustacheData]) throws -> String {
+        return try template.render(data: data)
+    }
+
+    /// Renders the cached template `name`, `source` is only called when it must be compiled.
+    public func render(named name: String, data: [String: MustacheData], source: () throws -> String) throws -> String {
+        return try self.cache.template(named: name, source: source).render(data: data)
+    }
+
+    /// Renders the cached template `name` in `output`
+    public func render<Output: MustacheOutputStream>(named name: String, data: [String: MustacheData], into output: inout Output, source: () throws -> String) throws {
+        try self.cache.template(named: name, source: source).render(data: data, into: &output)
     }
 }
+
+#if compiler(>=5.5)
+extension MustacheRenderer: Sendable { }
+#endif
@@ -0,0 +1,99 @@
+/// State of the renderings of the functions that the MustacheGeneratorPlugin
+/// generates from .mustache files: the data stack and the output.
+///
+/// The generated functions call it directly in the order of the template,
+/// they resolve names like the compiled templates do.
+public struct MustacheScope {
+    /// The partials taken from the data, compiled once for all the scopes
+    static let partials = MustacheCache()
+
+    var context: MustacheContext
+    /// The text rendered so far
+    public internal(set) var output: String
+
+    public init(data: [String: MustacheData]) {
+        self.context = MustacheContext(data: data)
+        self.output = ""
+    }
+
+    /// Appends the literal `text` of the template
+    public mutating func write(_ text: String) {
+        self.output += text
+    }
+
+    /// Puts the value of `key`, a name without segments
+    public mutating func put(_ key: String, escape: Bool) {
+        let data = key.utf8.contains(UInt8(ascii: ".")) ? self.context.get(name: key) : self.context.lookup(key: key)
+        self.append(self.context.string(of: data), escape: escape)
+    }
+
+    /// Puts the value of the dotted name of segments `path`
+    public mutating func put(path: [String], escape: Bool) {
+        guard self.walk(path[...]) else {
+            return
+        }
+        self.append(self.context.string(of: self.context.cursor), escape: escape)
+    }
+
+    /// Enters the section `key`, a name without segments
+    public mutating func enter(_ key: String) -> Bool {
+        let data = key.utf8.contains(UInt8(ascii: ".")) ? self.context.get(name: key) : self.context.lookup(key: key)
+        return self.context.enter(data: data)
+    }
+
+    /// Enters the section of the dotted name of segments `path`
+    public mutating func enter(path: [String]) -> Bool {
+        guard self.walk(path.dropLast()), let cursor = self.context.cursor else {
+            return false
+        }
+        return self.context.enter(data: self.context.child(key: path[path.count - 1], of: cursor))
+    }
+
+    /// Moves to the next item of the current section
+    public mutating func next() -> Bool {
+        return self.context.next()
+    }
+
+    public mutating func leave() {
+        self.context.leave()
+    }
+
+    /// Renders the partial `name` that is not a generated template: its
+    /// text is taken from the data and compiled once, the next renderings
+    /// of the same text reuse it.
+    public mutating func partial(_ name: String) throws {
+        let text = self.context.put(name: name)
+        guard !text.isEmpty else {
+            return
+        }
+        let template = try MustacheScope.partials.template(for: text)
+        try template.render(stack: self.context.stack, index: self.context.index, into: &self.output)
+    }
+
+    mutating func walk(_ path: ArraySlice<String>) -> Bool {
+        var first = true
+        for key in path {
+            guard self.context.walk(first: first, key: key) else {
+                return false
+            }
+            first = false
+        }
+        return true
+    }
+
+    /// Appends `value`, escaping the HTML characters like mustach does
+    mutating func append(_ value: String, escape: Bool) {
+        guard escape, value.utf8.contains(where: { $0 == UInt8(ascii: "<") || $0 == UInt8(ascii: ">") || $0 == UInt8(ascii: "&") }) else {
+            self.output += value
+            return
+        }
+        for scalar in value.unicodeScalars {
+            switch scalar {
+            case "<": self.output += "&lt;"
+            case ">": self.output += "&gt;"
+            case "&": self.output += "&amp;"
+            default: self.output.unicodeScalars.append(scalar)
+            }
+        }
+    }
+}
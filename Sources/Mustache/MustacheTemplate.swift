@@ -0,0 +1,219 @@
+import CMustache
+
+/// A compiled template, created once and rendered many times.
+///
+/// A template is immutable: it can be shared and rendered concurrently.
+public final class MustacheTemplate {
+    let program: OpaquePointer
+    /// Names of the symbols of the program, indexed by symbol
+    let symbols: [String]
+    /// Texts of the partials that are not inlined
+    let partials: [String: String]
+    /// Running estimate of the size of the renderings, updated atomically by mustach
+    let estimate: UnsafeMutablePointer<Int>
+
+    public convenience init(_ template: String) throws {
+        var template = template
+        let program = try template.withUTF8 { template in
+            try MustacheTemplate.compile(UnsafeRawBufferPointer(template))
+        }
+        self.init(program: program)
+    }
+
+    public convenience init(bytes template: [UInt8]) throws {
+        let program = try template.withUnsafeBytes { template in
+            try MustacheTemplate.compile(template)
+        }
+        self.init(program: program)
+    }
+
+    /// Compiles the UTF-8 `template`, it is not required to be zero terminated.
+    public convenience init(bytes template: UnsafeRawBufferPointer) throws {
+        self.init(program: try MustacheTemplate.compile(template))
+    }
+
+    /// Compiles `template` with the `partials` it includes inlined. The
+    /// partials including themselves are kept and included when rendering.
+    public convenience init(_ template: String, partials: [String: String]) throws {
+        var template = template
+        var resolver = MustachePartials(partials: partials)
+        defer { resolver.deallocate() }
+        let program = try template.withUTF8 { template in
+            try MustacheTemplate.compile(UnsafeRawBufferPointer(template), partials: &resolver)
+        }
+        self.init(program: program, partials: partials)
+    }
+
+    /// Compiles `template` without copying its texts, for a template rendered
+    /// once: `template` must remain valid as long as the compiled template.
+    convenience init(inPlace template: UnsafeRawBufferPointer) throws {
+        var program: OpaquePointer?
+        let status = mustach_compile_inplace(
+            template.baseAddress?.assumingMemoryBound(to: Int8.self),
+            template.count,
+            &program
+        )
+        guard status == MUSTACH_OK, let compiled = program else {
+            throw MustacheError(status: status)
+        }
+        self.init(program: compiled)
+    }
+
+    init(program: OpaquePointer, partials: [String: String] = [:]) {
+        self.program = program
+        self.symbols = MustacheContext.symbols(of: program)
+        self.partials = partials
+        self.estimate = UnsafeMutablePointer<Int>.allocate(capacity: 1)
+        self.estimate.initialize(to: 0)
+    }
+
+    deinit {
+        mustach_program_free(self.program)
+        self.estimate.deallocate()
+    }
+
+    static func compile(_ template: UnsafeRawBufferPointer) throws -> OpaquePointer {
+        var program: OpaquePointer?
+        let status = mustach_compile(
+            template.baseAddress?.assumingMemoryBound(to: Int8.self),
+            template.count,
+            &program
+        )
+        guard status == MUSTACH_OK, let compiled = program else {
+            throw MustacheError(status: status)
+        }
+        return compiled
+    }
+
+    static func compile(_ template: UnsafeRawBufferPointer, partials: inout MustachePartials) throws -> OpaquePointer {
+        var program: OpaquePointer?
+        let status = withUnsafeMutablePointer(to: &partials) { resolver in
+            mustach_compile_inline(
+                template.baseAddress?.assumingMemoryBound(to: Int8.self),
+                template.count,
+                { closure, name, length, sbuf in
+                    guard let name = name, let sbuf = sbuf else {
+                        return MUSTACH_ERROR_SYSTEM
+                    }
+                    guard let partials = closure?.assumingMemoryBound(to: MustachePartials.self) else {
+                        return MUSTACH_ERROR_SYSTEM
+                    }
+                    return partials.pointee.resolve(MustacheContext.name(name, length), in: sbuf) ? 1 : 0
+                },
+                resolver,
+                &program
+            )
+        }
+        guard status == MUSTACH_OK, let compiled = program else {
+            throw MustacheError(status: status)
+        }
+        return compiled
+    }
+
+    /// Size in bytes of the compiled template, with the names of its
+    /// symbols and the texts of the partials it keeps
+    public var size: Int {
+        let symbols = self.symbols.reduce(0) { size, symbol in
+            size + MemoryLayout<String>.stride + symbol.utf8.count
+        }
+        let partials = self.partials.reduce(0) { size, partial in
+            size + 2 * MemoryLayout<String>.stride + partial.key.utf8.count + partial.value.utf8.count
+        }
+        return mustach_program_size(self.program) + symbols + partials
+    }
+
+    /// Expected size in bytes of a rendering: the length of the texts of
+    /// the template or, when bigger, the running estimate of the previous
+    /// renderings. The renderings allocate their output at once to it.
+    public var sizeHint: Int {
+        var options = self.options
+        return mustach_size_hint(self.program, &options)
+    }
+
+    var options: mustach_options {
+        var options = mustach_options()
+        options.estimate = self.estimate
+        return options
+    }
+
+    public func render(data: [String: MustacheData]) throws -> String {
+        return try self.render(stack: [.dictionary(data)], index: 0)
+    }
+
+    /// Renders in `output`, written by pieces as they are produced: appended
+    /// to an `[UInt8]` or a `String`, written to a `MustacheFileOutput`...
+    public func render<Output: MustacheOutputStream>(data: [String: MustacheData], into output: inout Output) throws {
+        try self.render(stack: [.dictionary(data)], index: 0, into: &output)
+    }
+
+    /// Renders in `buffer`, replacing its content but keeping its memory
+    public func render(data: [String: MustacheData], into buffer: MustacheBuffer) throws {
+        var buffer = buffer
+        buffer.bytes.removeAll(keepingCapacity: true)
+        try self.render(stack: [.dictionary(data)], index: 0, into: &buffer)
+    }
+
+    /// Renders from the data `stack` of a rendering in progress
+    func render(stack: [MustacheData], index: Int) throws -> String {
+        var bytes: [UInt8] = []
+        try self.render(stack: stack, index: index, into: &bytes)
+        return String(decoding: bytes, as: UTF8.self)
+    }
+
+    func render<Output: MustacheOutputStream>(stack: [MustacheData], index: Int, into output: inout Output) throws {
+        var context = MustacheContext(stack: stack, index: index, symbols: self.symbols, partials: self.partials)
+        defer { context.deallocate() }
+        var itf = context.itf
+        var options = self.options
+
+        try output.write(expecting: self.sizeHint) { write in
+            try withoutActuallyEscaping(write) { write in
+                var writer = MustacheWriter(write: write, error: nil)
+                let status = mustach_exec2_write(self.program, &itf, &context, &options, MustacheWriter.function, &writer)
+                if let error = writer.error {
+                    throw error
+                }
+                guard status == MUSTACH_OK else {
+                    throw MustacheError(status: status)
+                }
+            }
+        }
+    }
+}
+
+/// Gives the texts of the partials to mustach_compile_inline, they stay
+/// allocated until deallocated as inlined partials are nested.
+struct MustachePartials {
+    let partials: [String: String]
+    var texts: [UnsafeMutableBufferPointer<CChar>] = []
+
+    init(partials: [String: String]) {
+        self.partials = partials
+    }
+
+    mutating func resolve(_ name: String, in sbuf: UnsafeMutablePointer<mustach_sbuf>) -> Bool {
+        guard var text = self.partials[name] else {
+            return false
+        }
+        let buffer = text.withUTF8 { utf8 -> UnsafeMutableBufferPointer<CChar> in
+            let buffer = UnsafeMutableBufferPointer<CChar>.allocate(capacity: utf8.count + 1)
+            UnsafeMutableRawBufferPointer(buffer).copyMemory(from: UnsafeRawBufferPointer(utf8))
+            buffer[utf8.count] = 0
+            return buffer
+        }
+        self.texts.append(buffer)
+        sbuf.pointee.value = UnsafePointer(buffer.baseAddress)
+        sbuf.pointee.length = buffer.count - 1
+        return true
+    }
+
+    func deallocate() {
+        for text in self.texts {
+            text.deallocate()
+        }
+    }
+}
+
+#if compiler(>=5.5)
+extension MustacheTemplate: @unchecked Sendable { }
+#endif
@@ -0,0 +1,34 @@
+import Foundation
+import Mustache
+
+// Compares the rendering of listing.mustache interpreted by mustach with
+// the function generated by the MustacheGeneratorPlugin:
+//
+//     swift run -c release MustacheBench
+
+let rows = (0..<5000).map { id -> MustacheData in
+    ["id": .string(String(id)), "name": "A fine product", "price": "12.50"]
+}
+let data: [String: MustacheData] = ["rows": .array(rows)]
+let count = 50
+
+func report(_ label: String, _ body: () throws -> String) rethrows -> String {
+    var result = ""
+    let start = Date()
+    for _ in 0..<count {
+        result = try body()
+    }
+    let nanoseconds = Date().timeIntervalSince(start) * 1e9 / Double(count)
+    print("  " + label.padding(toLength: 32, withPad: " ", startingAt: 0) + String(format: " %10.1f ns/op %12d ops", nanoseconds, count))
+    return result
+}
+
+let source = try String(contentsOf: URL(fileURLWithPath: #filePath).deletingLastPathComponent().appendingPathComponent("listing.mustache"))
+let template = try MustacheTemplate(source)
+print("generated")
+let interpreted = try report("interpreted 5000 rows") { try template.render(data: data) }
+let generated = try report("generated 5000 rows") { try MustacheTemplates.listing(data) }
+if interpreted != generated {
+    print("the renderings differ")
+    exit(1)
+}
@@ -0,0 +1,186 @@
+import CMustache
+import Foundation
+
+// Generates the Swift render functions of .mustache files, run by the
+// MustacheGeneratorPlugin at build time:
+//
+//     MustacheGenerator OUTPUT ROOT TEMPLATE...
+//
+// Each TEMPLATE is named by its path relative to ROOT without extension,
+// "mail/welcome.mustache" is the partial "mail/welcome" and is rendered by
+// `MustacheTemplates.mailWelcome(data)`. The templates are compiled by
+// mustach, the literal texts become static strings and the tags direct
+// calls to MustacheScope.
+
+struct Template {
+    let path: String
+    let name: String
+    let identifier: String
+    let program: OpaquePointer
+}
+
+func fail(_ message: String) -> Never {
+    FileHandle.standardError.write("\(message)\n".data(using: .utf8)!)
+    exit(1)
+}
+
+/// Identifier of the template `name`: "mail/user-list" is `mailUserList`
+func identifier(of name: String) -> String {
+    let words = name.split(whereSeparator: { !($0.isLetter || $0.isNumber || $0 == "_") })
+    var identifier = words.enumerated().map { index, word -> String in
+        index == 0 ? word.prefix(1).lowercased() + word.dropFirst() : word.prefix(1).uppercased() + word.dropFirst()
+    }.joined()
+    if identifier.first.map({ !$0.isLetter && $0 != "_" }) ?? true {
+        identifier = "_" + identifier
+    }
+    return identifier
+}
+
+/// Swift literal of the UTF-8 `text`
+func literal(_ text: String) -> String {
+    var literal = "\""
+    for scalar in text.unicodeScalars {
+        switch scalar {
+        case "\\": literal += "\\\\"
+        case "\"": literal += "\\\""
+        case "\n": literal += "\\n"
+        case "\r": literal += "\\r"
+        case "\t": literal += "\\t"
+        default:
+            if scalar.value < 0x20 || scalar.value == 0x7f {
+                literal += "\\u{\(String(scalar.value, radix: 16))}"
+            } else {
+                literal.unicodeScalars.append(scalar)
+            }
+        }
+    }
+    return literal + "\""
+}
+
+/// Arguments of the calls of MustacheScope for `name`, split like the
+/// dotted names of mustach: at least two segments and none empty
+func reference(_ name: String) -> String {
+    let segments = name.split(separator: ".", omittingEmptySubsequences: false)
+    if segments.count < 2 || segments.contains(where: { $0.isEmpty }) {
+        return literal(name)
+    }
+    return "path: [" + segments.map { literal(String($0)) }.joined(separator: ", ") + "]"
+}
+
+func compile(_ path: String) -> OpaquePointer {
+    guard let data = FileManager.default.contents(atPath: path) else {
+        fail("\(path): error: can't read the template")
+    }
+    var program: OpaquePointer?
+    let status = data.withUnsafeBytes { bytes in
+        mustach_compile(bytes.baseAddress?.assumingMemoryBound(to: Int8.self), bytes.count, &program)
+    }
+    guard status == MUSTACH_OK, let compiled = program else {
+        fail("\(path): error: invalid mustache template (\(status))")
+    }
+    return compiled
+}
+
+/// Body of the function rendering `template` in `scope`
+func body(of template: Template, templates: [String: Template]) -> [String] {
+    var lines: [String] = []
+    var indent = "        "
+    for index in 0..<mustach_program_count(template.program) {
+        var text: UnsafePointer<CChar>?
+        var length = 0
+        let code = mustach_program_op(template.program, index, &text, &length, nil)
+        let value = String(decoding: UnsafeRawBufferPointer(start: text, count: length), as: UTF8.self)
+        switch UInt32(code) {
+        case MUSTACH_OP_TEXT.rawValue:
+            lines.append(indent + "scope.write(\(literal(value)))")
+        case MUSTACH_OP_PUT.rawValue:
+            lines.append(indent + "scope.put(\(reference(value)), escape: true)")
+        case MUSTACH_OP_PUT_RAW.rawValue:
+            lines.append(indent + "scope.put(\(reference(value)), escape: false)")
+        case MUSTACH_OP_SECTION.rawValue:
+            lines.append(indent + "if scope.enter(\(reference(value))) {")
+            lines.append(indent + "    repeat {")
+            indent += "        "
+        case MUSTACH_OP_INVERTED.rawValue:
+            lines.append(indent + "if scope.enter(\(reference(value))) {")
+            lines.append(indent + "    scope.leave()")
+            lines.append(indent + "} else {")
+            indent += "    "
+        case MUSTACH_OP_END.rawValue:
+            var jump: UInt32 = 0
+            _ = mustach_program_op(template.program, index, nil, nil, &jump)
+            if UInt32(mustach_program_op(template.program, jump, nil, nil, nil)) == MUSTACH_OP_SECTION.rawValue {
+                indent.removeLast(8)
+                lines.append(indent + "    } while scope.next()")
+                lines.append(indent + "    scope.leave()")
+            } else {
+                indent.removeLast(4)
+            }
+            lines.append(indent + "}")
+        case MUSTACH_OP_PARTIAL.rawValue:
+            if let partial = templates[value] {
+                lines.append(indent + "try MustacheTemplates.`\(partial.identifier)`(&scope)")
+            } else {
+                lines.append(indent + "try scope.partial(\(literal(value)))")
+            }
+        default:
+            fail("\(template.path): error: unknown operation \(code)")
+        }
+    }
+    return lines
+}
+
+let arguments = CommandLine.arguments
+guard arguments.count >= 3 else {
+    fail("usage: MustacheGenerator OUTPUT ROOT TEMPLATE...")
+}
+let root = URL(fileURLWithPath: arguments[2]).standardizedFileURL.path
+var templates: [String: Template] = [:]
+var identifiers: [String: String] = [:]
+for path in arguments[3...] {
+    let file = URL(fileURLWithPath: path).standardizedFileURL
+    var name = file.deletingPathExtension().path
+    if name.hasPrefix(root + "/") {
+        name.removeFirst(root.count + 1)
+    } else {
+        name = file.deletingPathExtension().lastPathComponent
+    }
+    let template = Template(path: path, name: name, identifier: identifier(of: name), program: compile(path))
+    if let other = identifiers[template.identifier] {
+        fail("\(path): error: the templates \(other) and \(name) have the same function \(template.identifier)")
+    }
+    identifiers[template.identifier] = name
+    templates[name] = template
+}
+
+var lines = [
+    "// Generated by MustacheGenerator from the .mustache files, do not edit.",
+    "import Mustache",
+    "",
+    "enum MustacheTemplates {",
+]
+for name in templates.keys.sorted() {
+    let template = templates[name]!
+    lines.append("    /// Renders the template \(name)")
+    lines.append("    static func `\(template.identifier)`(_ data: [String: MustacheData]) throws -> String {")
+    lines.append("        var scope = MustacheScope(data: data)")
+    lines.append("        try `\(template.identifier)`(&scope)")
+    lines.append("        return scope.output")
+    lines.append("    }")
+    lines.append("")
+    lines.append("    static func `\(template.identifier)`(_ scope: inout MustacheScope) throws {")
+    lines += body(of: template, templates: templates)
+    lines.append("    }")
+    lines.append("")
+}
+lines.append("}")
+lines.append("")
+
+do {
+    try lines.joined(separator: "\n").write(toFile: arguments[1], atomically: true, encoding: .utf8)
+} catch {
+    fail("\(arguments[1]): error: \(error)")
+}
+for template in templates.values {
+    mustach_program_free(template.program)
+}
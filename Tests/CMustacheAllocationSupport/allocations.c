@@ -0,0 +1,191 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mustach.h"
+#include "mustach_allocations.h"
+
+/*
+ * The allocations are counted with glibc, whose functions can be replaced
+ * by the program. They are counted only while 'counting' is set: the
+ * other tests of the process only go through the wrappers.
+ */
+static int counting;
+static size_t allocations;
+
+#if defined(__GLIBC__)
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *pointer, size_t size);
+
+static void counted(void)
+{
+    if (__atomic_load_n(&counting, __ATOMIC_RELAXED))
+        __atomic_add_fetch(&allocations, 1, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size)
+{
+    counted();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    counted();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    counted();
+    return __libc_realloc(pointer, size);
+}
+
+int mustach_allocations_counted(void)
+{
+    return 1;
+}
+#else
+int mustach_allocations_counted(void)
+{
+    return 0;
+}
+#endif
+
+/* a log line, its message and its data */
+static const char line[] =
+    "{{level}} [{{module}}] {{#user}}user={{name}} {{/user}}{{>message}}\n";
+static const char message[] = "request of {{path}} in {{time}} ms";
+
+static const char *const values[] = {
+    "level", "INFO", "module", "http", "name", "john", "path", "/index", "time", "12", NULL
+};
+
+static int enter(void *closure, const char *name, size_t length)
+{
+    int *entered = closure;
+
+    if (*entered || length != 4 || memcmp(name, "user", 4))
+        return 0;
+    *entered = 1;
+    return 1;
+}
+
+static int next(void *closure)
+{
+    (void)closure; /* unused */
+    return 0;
+}
+
+static int leave(void *closure)
+{
+    int *entered = closure;
+    *entered = 0;
+    return MUSTACH_OK;
+}
+
+static int get(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    const char *const *iter;
+
+    (void)closure; /* unused */
+    for (iter = values ; *iter != NULL ; iter += 2)
+        if (!strncmp(iter[0], name, length) && !iter[0][length]) {
+            sbuf->value = iter[1];
+            sbuf->length = strlen(iter[1]);
+            break;
+        }
+    return MUSTACH_OK;
+}
+
+static int partial(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    (void)closure; /* unused */
+    if (length == 7 && !memcmp(name, "message", 7)) {
+        sbuf->value = message;
+        sbuf->length = sizeof message - 1;
+    }
+    return MUSTACH_OK;
+}
+
+static struct mustach_itf2 itf = {
+    .enter = enter,
+    .next = next,
+    .leave = leave,
+    .partial = partial,
+    .get = get,
+};
+
+int mustach_allocations_buffer(void)
+{
+    static const char expected[] = "INFO [http] user=john request of /index in 12 ms\n";
+    struct mustach_program *program;
+    struct mustach_options options;
+    char buffer[256];
+    size_t length, full;
+    int i, rc, entered, failures;
+
+    rc = mustach_compile(line, sizeof line - 1, &program);
+    if (rc < 0) {
+        fprintf(stderr, "mustach_compile failed (%d)\n", rc);
+        return 1;
+    }
+    memset(&options, 0, sizeof options);
+    rc = mustach_partials_create(&options.partials);
+    if (rc < 0) {
+        fprintf(stderr, "mustach_partials_create failed (%d)\n", rc);
+        mustach_program_free(program);
+        return 1;
+    }
+
+    /* the partial is compiled by the first rendering, then found in the cache */
+    failures = 0;
+    for (i = 0 ; i < 100 ; i++) {
+        entered = 0;
+        rc = mustach_exec2_buffer(program, &itf, &entered, &options, buffer, sizeof buffer, &length);
+        if (rc < 0 || length != sizeof expected - 1 || strcmp(buffer, expected)) {
+            fprintf(stderr, "mustach_exec2_buffer failed (%d) or rendered: %s\n", rc, rc < 0 ? "" : buffer);
+            failures++;
+            break;
+        }
+        if (i == 0) {
+            allocations = 0;
+            __atomic_store_n(&counting, 1, __ATOMIC_RELAXED);
+        }
+    }
+    __atomic_store_n(&counting, 0, __ATOMIC_RELAXED);
+    if (allocations != 0) {
+        fprintf(stderr, "mustach_exec2_buffer allocated %zu times\n", allocations);
+        failures++;
+    }
+
+    /* too small, the needed size is given */
+    full = sizeof expected;
+    entered = 0;
+    rc = mustach_exec2_buffer(program, &itf, &entered, &options, buffer, 8, &length);
+    if (rc != MUSTACH_ERROR_TOO_SMALL || length != full) {
+        fprintf(stderr, "mustach_exec2_buffer too small returned %d and %zu\n", rc, length);
+        failures++;
+    }
+
+    mustach_partials_free(options.partials);
+    mustach_program_free(program);
+    return failures;
+}
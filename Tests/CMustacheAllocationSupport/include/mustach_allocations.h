@@ -0,0 +1,41 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef _mustach_allocations_h_included_
+#define _mustach_allocations_h_included_
+
+/*
+ * Checks of the allocations of the C engine run by the
+ * CMustacheAllocationTests. The allocations are counted by replacing the
+ * allocation functions of glibc for the whole process, they are not
+ * counted with other C libraries. Each check returns 0 if it passes or
+ * the count of its failures, described on the standard error.
+ */
+
+/**
+ * mustach_allocations_counted - Returns 1 if the allocations are counted,
+ * 0 if the checks can't count them and must be skipped.
+ */
+extern int mustach_allocations_counted(void);
+
+/**
+ * mustach_allocations_buffer - Checks that mustach_exec2_buffer renders
+ * without allocating a program whose partials are cached and that it
+ * gives the size needed when the buffer is too small.
+ */
+extern int mustach_allocations_buffer(void);
+
+#endif
@@ -0,0 +1,17 @@
+import XCTest
+import CMustacheAllocationSupport
+
+/// Runs the checks of the allocations of the C engine, their failures are
+/// described on the standard error
+final class CMustacheAllocationTests: XCTestCase {
+    func testBuffer() throws {
+        guard mustach_allocations_counted() != 0 else {
+            #if compiler(>=5.3)
+            throw XCTSkip("the allocations are only counted with glibc")
+            #else
+            return
+            #endif
+        }
+        XCTAssertEqual(mustach_allocations_buffer(), 0)
+    }
+}
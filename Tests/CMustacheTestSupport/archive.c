@@ -0,0 +1,178 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tests.h"
+
+/* count of the programs of the archive */
+#define PROGRAMS 200
+
+struct programs {
+    char names[PROGRAMS][16];
+    const char *pnames[PROGRAMS];
+    struct mustach_program *programs[PROGRAMS];
+    char *expected[PROGRAMS];
+    size_t lengths[PROGRAMS];
+};
+
+/* renders the programs of the archive and compares them with the renderings of the programs written */
+static int check(const struct mustach_archive *archive, const struct programs *programs, const char *what)
+{
+    const struct mustach_program *program;
+    struct test_context context;
+    char *result;
+    size_t length;
+    int i, rc, failures;
+
+    failures = 0;
+    if (mustach_archive_count(archive) != PROGRAMS)
+        failures += test_fail(what, "(count)", 7, (int)mustach_archive_count(archive));
+    for (i = 0 ; i < PROGRAMS ; i++) {
+        rc = mustach_archive_find(archive, programs->names[i], strlen(programs->names[i]), &program);
+        if (rc < 0) {
+            failures += test_fail(what, programs->names[i], strlen(programs->names[i]), rc);
+            continue;
+        }
+        test_context_init(&context);
+        rc = mustach_exec2_mem(program, &test_itf, &context, NULL, &result, &length);
+        if (rc < 0)
+            failures += test_fail(what, programs->names[i], strlen(programs->names[i]), rc);
+        else {
+            failures += test_compare(what, programs->names[i], strlen(programs->names[i]),
+                                     programs->expected[i], programs->lengths[i], result, length);
+            free(result);
+        }
+    }
+    rc = mustach_archive_find(archive, "missing", 7, &program);
+    if (rc != MUSTACH_ERROR_ITEM_NOT_FOUND)
+        failures += test_fail(what, "missing", 7, rc);
+    return failures;
+}
+
+/* writes the archive in 'path', then checks it opened, mapped and corrupted */
+static int check_archive(struct programs *programs, const char *path, FILE *file)
+{
+    struct mustach_archive *archive;
+    const struct mustach_program *program;
+    char *data;
+    size_t size;
+    int i, rc, failures;
+
+    rc = mustach_archive_write(file, programs->pnames, (const struct mustach_program *const*)programs->programs, PROGRAMS);
+    if (rc < 0)
+        return test_fail("mustach_archive_write", path, strlen(path), rc);
+    rc = test_contents(file, &data, &size);
+    if (rc < 0) {
+        free(data);
+        return test_fail("reading the archive", path, strlen(path), rc);
+    }
+
+    failures = 0;
+    rc = mustach_archive_open(&archive, path);
+    if (rc < 0)
+        failures += test_fail("mustach_archive_open", path, strlen(path), rc);
+    else {
+        failures += check(archive, programs, "mustach_archive_open");
+        mustach_archive_close(archive);
+    }
+
+    /* the blocks of malloc are aligned on 8 bytes at least */
+    rc = mustach_archive_map(&archive, data, size);
+    if (rc < 0)
+        failures += test_fail("mustach_archive_map", path, strlen(path), rc);
+    else {
+        rc = mustach_archive_find(archive, programs->names[PROGRAMS / 2], strlen(programs->names[PROGRAMS / 2]), &program);
+        failures += check(archive, programs, "mustach_archive_map");
+        mustach_archive_close(archive);
+
+        /* a program corrupted is rejected by each find, the program starts with its size */
+        if (rc == MUSTACH_OK) {
+            data[(const char*)program - data] ^= 1;
+            rc = mustach_archive_map(&archive, data, size);
+            if (rc < 0)
+                failures += test_fail("mustach_archive_map of a corrupted program", path, strlen(path), rc);
+            else {
+                for (i = 0 ; i < 2 ; i++) {
+                    rc = mustach_archive_find(archive, programs->names[PROGRAMS / 2], strlen(programs->names[PROGRAMS / 2]), &program);
+                    if (rc != MUSTACH_ERROR_BAD_ARCHIVE)
+                        failures += test_fail("rejecting a corrupted program", path, strlen(path), rc);
+                }
+                rc = mustach_archive_find(archive, programs->names[0], strlen(programs->names[0]), &program);
+                if (rc < 0)
+                    failures += test_fail("finding a program beside a corrupted one", path, strlen(path), rc);
+                mustach_archive_close(archive);
+            }
+        }
+    }
+    free(data);
+    return failures;
+}
+
+int mustach_tests_archive(void)
+{
+    struct programs *programs;
+    char template[TEST_LENGTH], path[] = "/tmp/mustach-tests-XXXXXX";
+    unsigned seed;
+    size_t length;
+    FILE *file;
+    int i, fd, rc, count, failures;
+
+    programs = calloc(1, sizeof *programs);
+    if (programs == NULL)
+        return 1;
+    failures = 0;
+    seed = 16;
+    for (count = 0 ; count < PROGRAMS ; count++) {
+        snprintf(programs->names[count], sizeof programs->names[count], "t%d", count);
+        programs->pnames[count] = programs->names[count];
+        length = test_template(&seed, template, sizeof template);
+        rc = mustach_compile(template, length, &programs->programs[count]);
+        if (rc == MUSTACH_OK) {
+            rc = test_reference(programs->programs[count], &programs->expected[count], &programs->lengths[count]);
+            if (rc < 0)
+                mustach_program_free(programs->programs[count]);
+        }
+        if (rc < 0) {
+            failures = test_fail("rendering a program to archive", template, length, rc);
+            break;
+        }
+    }
+
+    if (count == PROGRAMS) {
+        fd = mkstemp(path);
+        file = fd < 0 ? NULL : fdopen(fd, "w+b");
+        if (file == NULL) {
+            failures = test_fail("creating the archive", path, strlen(path), MUSTACH_ERROR_SYSTEM);
+            if (fd >= 0)
+                close(fd);
+        } else {
+            failures = check_archive(programs, path, file);
+            fclose(file);
+        }
+        if (fd >= 0)
+            unlink(path);
+    }
+
+    for (i = 0 ; i < count ; i++) {
+        mustach_program_free(programs->programs[i]);
+        free(programs->expected[i]);
+    }
+    free(programs);
+    return failures;
+}
@@ -0,0 +1,359 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tests.h"
+
+#define STRING(s)           { TEST_STRING, s, 0, NULL, NULL }
+#define OBJECT(names, items) { TEST_OBJECT, NULL, sizeof items / sizeof *items, names, items }
+#define ARRAY(items)        { TEST_ARRAY, NULL, sizeof items / sizeof *items, NULL, items }
+
+static const char *const item_names[] = { "name", "id" };
+static const struct test_value item0[] = { STRING("x & y"), STRING("1") };
+static const struct test_value item1[] = { STRING("<b>"), STRING("2") };
+static const struct test_value item2[] = { STRING(""), STRING("3") };
+static const struct test_value items[] = { OBJECT(item_names, item0), OBJECT(item_names, item1), OBJECT(item_names, item2) };
+
+static const char *const obj_names[] = { "x", "list", "name" };
+static const struct test_value obj_items[] = { STRING("\"quoted\""), ARRAY(items), STRING("inner") };
+
+static const char *const root_names[] = { "name", "html", "list", "obj", "empty", "no", "yes", "id" };
+static const struct test_value root_items[] = {
+    STRING("a & b"), STRING("<i>'</i>"), ARRAY(items), OBJECT(obj_names, obj_items),
+    { TEST_ARRAY, NULL, 0, NULL, NULL }, STRING("false"), STRING("yes"), STRING("0")
+};
+static const struct test_value root = OBJECT(root_names, root_items);
+
+static const char *const partials[] = {
+    "p", "[{{name}}]",
+    "q", "{{#list}}{{>p}}{{/list}}",
+    "r", "{{=| |=}}|html| (|&html|)",
+    NULL
+};
+
+void test_context_init(struct test_context *context)
+{
+    context->stack[0].value = &root;
+    context->stack[0].index = 0;
+    context->depth = 1;
+    context->partials = partials;
+    context->fetched = 0;
+}
+
+static const struct test_value *field(const struct test_value *value, const char *name, size_t length)
+{
+    size_t i;
+
+    if (value == NULL || value->type != TEST_OBJECT)
+        return NULL;
+    for (i = 0 ; i < value->count ; i++)
+        if (!strncmp(value->names[i], name, length) && !value->names[i][length])
+            return &value->items[i];
+    return NULL;
+}
+
+static const struct test_value *current(struct test_context *context, int depth)
+{
+    const struct test_value *value = context->stack[depth].value;
+    return value->type == TEST_ARRAY ? &value->items[context->stack[depth].index] : value;
+}
+
+static const struct test_value *lookup(struct test_context *context, const char *name, size_t length)
+{
+    const struct test_value *value;
+    const char *dot, *end = name + length;
+    int depth;
+
+    dot = memchr(name, '.', length);
+    for (depth = context->depth ; depth-- ; ) {
+        value = field(current(context, depth), name, (size_t)((dot ? dot : end) - name));
+        if (value != NULL) {
+            while (value != NULL && dot != NULL) {
+                name = dot + 1;
+                dot = memchr(name, '.', (size_t)(end - name));
+                value = field(value, name, (size_t)((dot ? dot : end) - name));
+            }
+            return value;
+        }
+    }
+    return NULL;
+}
+
+static int enter(void *closure, const char *name, size_t length)
+{
+    struct test_context *context = closure;
+    const struct test_value *value = lookup(context, name, length);
+
+    if (value == NULL
+     || (value->type == TEST_ARRAY && value->count == 0)
+     || (value->type == TEST_STRING && (!value->string[0] || !strcmp(value->string, "false"))))
+        return 0;
+    if (context->depth == MUSTACH_MAX_DEPTH)
+        return MUSTACH_ERROR_TOO_DEEP;
+    context->stack[context->depth].value = value;
+    context->stack[context->depth].index = 0;
+    context->depth++;
+    return 1;
+}
+
+static int next(void *closure)
+{
+    struct test_context *context = closure;
+    int depth = context->depth - 1;
+
+    if (context->stack[depth].value->type != TEST_ARRAY
+     || context->stack[depth].index + 1 >= context->stack[depth].value->count)
+        return 0;
+    context->stack[depth].index++;
+    return 1;
+}
+
+static int leave(void *closure)
+{
+    struct test_context *context = closure;
+    context->depth--;
+    return MUSTACH_OK;
+}
+
+static int get(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    const struct test_value *value = lookup(closure, name, length);
+
+    if (value != NULL && value->type == TEST_STRING) {
+        sbuf->value = value->string;
+        sbuf->length = strlen(value->string);
+    }
+    return MUSTACH_OK;
+}
+
+static int partial(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    struct test_context *context = closure;
+    const char *const *iter;
+
+    context->fetched++;
+    sbuf->value = "";
+    sbuf->length = 0;
+    for (iter = context->partials ; *iter != NULL ; iter += 2)
+        if (!strncmp(iter[0], name, length) && !iter[0][length]) {
+            sbuf->value = iter[1];
+            sbuf->length = strlen(iter[1]);
+            break;
+        }
+    return MUSTACH_OK;
+}
+
+static int enter1(void *closure, const char *name)
+{
+    return enter(closure, name, strlen(name));
+}
+
+static int partial1(void *closure, const char *name, struct mustach_sbuf *sbuf)
+{
+    return partial(closure, name, strlen(name), sbuf);
+}
+
+static int get1(void *closure, const char *name, struct mustach_sbuf *sbuf)
+{
+    return get(closure, name, strlen(name), sbuf);
+}
+
+struct mustach_itf2 test_itf = {
+    .enter = enter,
+    .next = next,
+    .leave = leave,
+    .partial = partial,
+    .get = get,
+};
+
+struct mustach_itf test_itf1 = {
+    .enter = enter1,
+    .next = next,
+    .leave = leave,
+    .partial = partial1,
+    .get = get1,
+};
+
+/*
+ * Random templates
+ *
+ * The templates are well formed: their sections are closed and their
+ * tags use the separators in effect, changed from time to time.
+ */
+struct generator {
+    unsigned *seed;
+    char *buffer;
+    size_t size, length;
+    const char *opstr, *clstr;
+};
+
+/* room kept at the end of the buffer for the closing tags */
+#define GENERATOR_ROOM 256
+
+static const char *const texts[] = {
+    "Hello ", "<p>", "\n", " & ", "x", "}} not a tag ", "{ brace } ", "\"'", "é\t",
+};
+
+static const char *const names[] = {
+    "name", "html", "id", "obj.x", "obj.name", "missing", "obj.missing", " name ",
+};
+
+static const char *const sections[] = {
+    "list", "obj", "obj.list", "empty", "no", "yes", "missing",
+};
+
+unsigned test_random(unsigned *seed, unsigned count)
+{
+    /* xorshift */
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed % count;
+}
+
+static unsigned random_below(struct generator *gen, unsigned count)
+{
+    return test_random(gen->seed, count);
+}
+
+static void put(struct generator *gen, const char *string)
+{
+    size_t length = strlen(string);
+
+    if (gen->length + length < gen->size) {
+        memcpy(&gen->buffer[gen->length], string, length);
+        gen->length += length;
+    }
+}
+
+static void tag(struct generator *gen, const char *prefix, const char *name, const char *suffix)
+{
+    put(gen, gen->opstr);
+    put(gen, prefix);
+    put(gen, name);
+    put(gen, suffix);
+    put(gen, gen->clstr);
+}
+
+static void generate(struct generator *gen, int depth)
+{
+    static const char *const partial_names[] = { "p", "q", "r", "missing" };
+    const char *name;
+    unsigned count, i, j;
+
+    count = 1 + random_below(gen, 6);
+    for (i = 0 ; i < count && gen->length + GENERATOR_ROOM < gen->size ; i++) {
+        switch (random_below(gen, 12)) {
+        case 0:
+        case 1:
+            put(gen, texts[random_below(gen, sizeof texts / sizeof *texts)]);
+            break;
+        case 2:
+            /* long texts fill the buffers of the outputs */
+            for (j = random_below(gen, 400) ; j && gen->length + GENERATOR_ROOM < gen->size ; j--)
+                put(gen, "0123456789");
+            break;
+        case 3:
+        case 4:
+            tag(gen, "", names[random_below(gen, sizeof names / sizeof *names)], "");
+            break;
+        case 5:
+            if (!strcmp(gen->clstr, "}}"))
+                tag(gen, "{", names[random_below(gen, sizeof names / sizeof *names)], "}");
+            else
+                tag(gen, "&", names[random_below(gen, sizeof names / sizeof *names)], "");
+            break;
+        case 6:
+        case 7:
+            if (depth < 4) {
+                name = sections[random_below(gen, sizeof sections / sizeof *sections)];
+                tag(gen, random_below(gen, 3) ? "#" : "^", name, "");
+                generate(gen, depth + 1);
+                tag(gen, "/", name, "");
+            }
+            break;
+        case 8:
+            tag(gen, ">", partial_names[random_below(gen, sizeof partial_names / sizeof *partial_names)], "");
+            break;
+        case 9:
+            tag(gen, "! ", "comment", " ");
+            break;
+        case 10:
+            /* the partials are included with the separators in effect */
+            if (!strcmp(gen->opstr, "{{")) {
+                tag(gen, "=", "<% %>", "=");
+                gen->opstr = "<%";
+                gen->clstr = "%>";
+            } else {
+                tag(gen, "=", "{{ }}", "=");
+                gen->opstr = "{{";
+                gen->clstr = "}}";
+            }
+            break;
+        default:
+            tag(gen, "", "list", "");
+            break;
+        }
+    }
+}
+
+size_t test_template(unsigned *seed, char *buffer, size_t size)
+{
+    struct generator gen = { seed, buffer, size, 0, "{{", "}}" };
+
+    generate(&gen, 0);
+    return gen.length;
+}
+
+int test_reference(const struct mustach_program *program, char **result, size_t *length)
+{
+    struct test_context context;
+
+    test_context_init(&context);
+    return mustach_exec2_mem(program, &test_itf, &context, NULL, result, length);
+}
+
+int test_contents(FILE *file, char **result, size_t *length)
+{
+    long size;
+
+    *result = NULL;
+    if (fflush(file) || fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 || fseek(file, 0, SEEK_SET))
+        return MUSTACH_ERROR_SYSTEM;
+    *result = malloc((size_t)size + 1);
+    if (*result == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    *length = fread(*result, 1, (size_t)size, file);
+    return *length == (size_t)size ? MUSTACH_OK : MUSTACH_ERROR_SYSTEM;
+}
+
+int test_fail(const char *what, const char *template, size_t length, int rc)
+{
+    fprintf(stderr, "%s failed (%d) for the template: %.*s\n", what, rc, (int)length, template);
+    return 1;
+}
+
+int test_compare(const char *what, const char *template, size_t tlength,
+                 const char *expected, size_t elength, const char *result, size_t length)
+{
+    if (length == elength && (length == 0 || !memcmp(expected, result, length)))
+        return 0;
+    fprintf(stderr, "%s differs for the template: %.*s\nexpected: %.*s\nresult:   %.*s\n",
+            what, (int)tlength, template, (int)elength, expected, (int)length, result);
+    return 1;
+}
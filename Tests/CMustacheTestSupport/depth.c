@@ -0,0 +1,138 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tests.h"
+
+/* count of partials of the chain, more than the frames kept inline */
+#define CHAIN 20
+
+static const char template[] = "{{>d0}}";
+
+/* renders the chain of partials with 'options', expects the status 'expected' */
+static int check(const char *const *partials, const struct mustach_options *options, int expected, const char *what)
+{
+    struct mustach_program *program;
+    struct test_context context;
+    char *result = NULL, output[2 * CHAIN + 1];
+    size_t length;
+    int rc, failures = 0;
+
+    rc = mustach_compile(template, strlen(template), &program);
+    if (rc < 0)
+        return test_fail("mustach_compile", template, strlen(template), rc);
+    test_context_init(&context);
+    context.partials = partials;
+    rc = mustach_exec2_mem(program, &test_itf, &context, options, &result, &length);
+    if (rc != expected) {
+        fprintf(stderr, "%s: mustach_exec2_mem returned %d instead of %d\n", what, rc, expected);
+        failures++;
+    } else if (rc == MUSTACH_OK) {
+        memset(output, '(', CHAIN - 1);
+        memcpy(&output[CHAIN - 1], "end", 3);
+        memset(&output[CHAIN + 2], ')', CHAIN - 1);
+        failures += test_compare(what, template, strlen(template), output, 2 * CHAIN + 1, result, length);
+    }
+    free(result);
+    mustach_program_free(program);
+    return failures;
+}
+
+/* writes in 'buffer' 'count' nested sections around 'inner', returns 'buffer' */
+static char *nest(char *buffer, unsigned count, const char *inner)
+{
+    unsigned i;
+
+    buffer[0] = 0;
+    for (i = 0 ; i < count ; i++)
+        strcat(buffer, "{{#a}}");
+    strcat(buffer, inner);
+    for (i = 0 ; i < count ; i++)
+        strcat(buffer, "{{/a}}");
+    return buffer;
+}
+
+static int resolve(void *closure, const char *name, size_t length, struct mustach_sbuf *sbuf)
+{
+    (void)name; /* the only partial */
+    (void)length;
+    sbuf->value = closure;
+    sbuf->length = strlen(closure);
+    return 1;
+}
+
+/* inlines in 'outer' nested sections a partial of 'inner' nested sections, expects the status 'expected' */
+static int check_inline(unsigned outer, unsigned inner, int expected)
+{
+    static char template[12 * MUSTACH_MAX_DEPTH + 8], partial[12 * MUSTACH_MAX_DEPTH + 8];
+    struct mustach_program *program;
+    int rc;
+
+    nest(template, outer, "{{>p}}");
+    nest(partial, inner, "x");
+    rc = mustach_compile_inline(template, strlen(template), resolve, partial, &program);
+    if (rc == MUSTACH_OK)
+        mustach_program_free(program);
+    if (rc != expected) {
+        fprintf(stderr, "inlining %u sections in %u: mustach_compile_inline returned %d instead of %d\n",
+                inner, outer, rc, expected);
+        return 1;
+    }
+    return 0;
+}
+
+int mustach_tests_depth(void)
+{
+    static const char *const loop[] = { "d0", "-{{>d0}}", NULL };
+    char names[CHAIN][16], texts[CHAIN][24];
+    const char *partials[2 * CHAIN + 1];
+    struct mustach_options options;
+    unsigned i;
+    int failures;
+
+    /* the partial d<i> includes d<i+1> up to d<CHAIN-1> */
+    for (i = 0 ; i < CHAIN ; i++) {
+        snprintf(names[i], sizeof names[i], "d%u", i);
+        if (i + 1 < CHAIN)
+            snprintf(texts[i], sizeof texts[i], "({{>d%u}})", i + 1);
+        else
+            strcpy(texts[i], "end");
+        partials[2 * i] = names[i];
+        partials[2 * i + 1] = texts[i];
+    }
+    partials[2 * CHAIN] = NULL;
+
+    memset(&options, 0, sizeof options);
+    failures = check(partials, NULL, MUSTACH_OK, "nesting below MUSTACH_MAX_DEPTH");
+    options.max_depth = CHAIN;
+    failures += check(partials, &options, MUSTACH_OK, "nesting of max_depth");
+    options.max_depth = CHAIN - 1;
+    failures += check(partials, &options, MUSTACH_ERROR_TOO_DEEP, "nesting deeper than max_depth");
+    options.max_depth = 1;
+    failures += check(partials, &options, MUSTACH_ERROR_TOO_DEEP, "nesting deeper than max_depth");
+
+    /* a partial including itself stops at the maximum */
+    failures += check(loop, NULL, MUSTACH_ERROR_TOO_DEEP, "recursive partial");
+    options.max_depth = 3;
+    failures += check(loop, &options, MUSTACH_ERROR_TOO_DEEP, "recursive partial");
+
+    /* the sections of the inlined partials count in the nesting of their inclusion */
+    failures += check_inline(MUSTACH_MAX_DEPTH / 2, MUSTACH_MAX_DEPTH / 2, MUSTACH_OK);
+    failures += check_inline(MUSTACH_MAX_DEPTH / 2, MUSTACH_MAX_DEPTH / 2 + 1, MUSTACH_ERROR_TOO_DEEP);
+    return failures;
+}
@@ -0,0 +1,182 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tests.h"
+
+/* renders 'program' with mustach_exec2_fd and a buffer of 'buffer' bytes in a temporary file */
+static int render(const struct mustach_program *program, size_t buffer, char **result, size_t *length)
+{
+    struct mustach_options options;
+    struct test_context context;
+    FILE *file;
+    int rc;
+
+    *result = NULL;
+    file = tmpfile();
+    if (file == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    memset(&options, 0, sizeof options);
+    options.buffer = buffer;
+    test_context_init(&context);
+    rc = mustach_exec2_fd(program, &test_itf, &context, &options, fileno(file));
+    if (rc == MUSTACH_OK)
+        rc = test_contents(file, result, length);
+    fclose(file);
+    return rc;
+}
+
+/* renders 'template' with mustach_fd in a temporary file */
+static int render_template(const char *template, size_t length, char **result, size_t *rlength)
+{
+    struct test_context context;
+    FILE *file;
+    int rc;
+
+    *result = NULL;
+    file = tmpfile();
+    if (file == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    test_context_init(&context);
+    rc = mustach_fd(template, length, &test_itf1, &context, fileno(file));
+    if (rc == MUSTACH_OK)
+        rc = test_contents(file, result, rlength);
+    fclose(file);
+    return rc;
+}
+
+static int check(const char *template, size_t length, unsigned *seed)
+{
+    struct mustach_program *program;
+    char *expected, *result;
+    size_t elength, rlength, buffer;
+    int rc, failures;
+
+    rc = mustach_compile(template, length, &program);
+    if (rc < 0)
+        return test_fail("mustach_compile", template, length, rc);
+    rc = test_reference(program, &expected, &elength);
+    if (rc < 0) {
+        mustach_program_free(program);
+        return test_fail("mustach_exec2_mem", template, length, rc);
+    }
+
+    /* small buffers are filled and flushed often, 0 is the default size */
+    buffer = test_random(seed, 4) ? 1 + test_random(seed, 64) : 0;
+    rc = render(program, buffer, &result, &rlength);
+    if (rc < 0)
+        failures = test_fail("mustach_exec2_fd", template, length, rc);
+    else
+        failures = test_compare("mustach_exec2_fd", template, length, expected, elength, result, rlength);
+    free(result);
+
+    rc = render_template(template, length, &result, &rlength);
+    if (rc < 0)
+        failures += test_fail("mustach_fd", template, length, rc);
+    else
+        failures += test_compare("mustach_fd", template, length, expected, elength, result, rlength);
+    free(result);
+
+    free(expected);
+    mustach_program_free(program);
+    return failures;
+}
+
+/* the end of the pipe read by 'drain' */
+static int drained;
+
+/* reads what the pipe 'drained' holds, returns its count of bytes */
+static size_t drain(void)
+{
+    char buffer[4096];
+    ssize_t n;
+    size_t count = 0;
+
+    while ((n = read(drained, buffer, sizeof buffer)) > 0)
+        count += (size_t)n;
+    return count;
+}
+
+static void stop(void *closure, int status)
+{
+    (void)closure; /* unused */
+    (void)status;
+    drain();
+}
+
+/* a failed write is not sent again by the final flush, even when the file accepts it */
+static int check_failure(void)
+{
+    static const char template[] = "abcdefgh{{id}}";
+    struct mustach_program *program;
+    struct mustach_options options;
+    struct mustach_itf2 itf = test_itf;
+    struct test_context context;
+    int fds[2], rc, failures;
+    size_t count;
+
+    rc = mustach_compile(template, strlen(template), &program);
+    if (rc < 0)
+        return test_fail("mustach_compile", template, strlen(template), rc);
+    if (pipe(fds) < 0) {
+        mustach_program_free(program);
+        return test_fail("pipe", template, strlen(template), MUSTACH_ERROR_SYSTEM);
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    drained = fds[0];
+
+    /* the pipe is full: the buffer of 8 bytes fails to be written, then 'stop' empties the pipe */
+    while (write(fds[1], "x", 1) == 1);
+    memset(&options, 0, sizeof options);
+    options.buffer = 8;
+    itf.stop = stop;
+    test_context_init(&context);
+    rc = mustach_exec2_fd(program, &itf, &context, &options, fds[1]);
+    failures = 0;
+    if (rc != MUSTACH_ERROR_SYSTEM)
+        failures += test_fail("mustach_exec2_fd in a full pipe", template, strlen(template), rc);
+    count = drain();
+    if (count != 0) {
+        fprintf(stderr, "mustach_exec2_fd wrote %zu bytes after a failed write\n", count);
+        failures++;
+    }
+    close(fds[0]);
+    close(fds[1]);
+    mustach_program_free(program);
+    return failures;
+}
+
+int mustach_tests_fd(void)
+{
+    char template[TEST_LENGTH];
+    unsigned seed, i;
+    size_t length;
+    int failures;
+
+    failures = 0;
+    seed = 20;
+    for (i = 0 ; i < TEST_TEMPLATES ; i++) {
+        length = test_template(&seed, template, sizeof template);
+        failures += check(template, length, &seed);
+    }
+    failures += check_failure();
+    return failures;
+}
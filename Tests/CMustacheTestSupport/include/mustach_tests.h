@@ -0,0 +1,78 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef _mustach_tests_h_included_
+#define _mustach_tests_h_included_
+
+/*
+ * Checks of the C engine run by the CMustacheTests. The checks of the
+ * entry points render random templates with them and compare the outputs
+ * with the ones of mustach_exec2_mem. Each check returns 0 if it passes
+ * or the count of its failures, described on the standard error.
+ */
+
+/**
+ * mustach_tests_partials - Checks that a cache of partials keeps the
+ * compiled partials across renderings and fetches again the partials
+ * invalidated.
+ */
+extern int mustach_tests_partials(void);
+
+/**
+ * mustach_tests_inplace - Checks the programs of mustach_compile_inplace
+ * and the renderings of templates by mustach_mem that compile in place.
+ */
+extern int mustach_tests_inplace(void);
+
+/**
+ * mustach_tests_depth - Checks that partials nested up to 'max_depth'
+ * render and that deeper ones fail with MUSTACH_ERROR_TOO_DEEP.
+ */
+extern int mustach_tests_depth(void);
+
+/**
+ * mustach_tests_step - Checks the renderings by steps of random sizes and
+ * the calls of 'stop' when 'start' fails or when released before the end.
+ */
+extern int mustach_tests_step(void);
+
+/**
+ * mustach_tests_stream - Checks the renderings of templates read by
+ * pieces of random sizes by mustach_stream and of templates read from a
+ * file by mustach_stream_fd.
+ */
+extern int mustach_tests_stream(void);
+
+/**
+ * mustach_tests_archive - Checks the renderings of the programs written
+ * in an archive, once opened or mapped, and that a corrupted program is
+ * rejected when the archive is opened.
+ */
+extern int mustach_tests_archive(void);
+
+/**
+ * mustach_tests_iov - Checks the segments of mustach_exec2_iov and the
+ * output of mustach_exec2_writev.
+ */
+extern int mustach_tests_iov(void);
+
+/**
+ * mustach_tests_fd - Checks the outputs of mustach_exec2_fd with buffers
+ * of random sizes and of mustach_fd.
+ */
+extern int mustach_tests_fd(void);
+
+#endif
@@ -0,0 +1,116 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tests.h"
+
+/* checks that the texts of 'program' are in 'template' of 'length' */
+static int check_texts(const struct mustach_program *program, const char *template, size_t length)
+{
+    const char *text;
+    size_t size;
+    unsigned i;
+
+    for (i = 0 ; i < mustach_program_count(program) ; i++)
+        if (mustach_program_op(program, i, &text, &size, NULL) == MUSTACH_OP_TEXT
+         && (text < template || text + size > template + length))
+            return test_fail("a text of mustach_compile_inplace not in place", template, length, 0);
+    return 0;
+}
+
+static int check(const char *template, size_t length)
+{
+    struct mustach_program *reference, *program;
+    struct test_context context;
+    char *expected, *result;
+    size_t elength, rlength;
+    int rc, failures;
+
+    rc = mustach_compile(template, length, &reference);
+    if (rc < 0)
+        return test_fail("mustach_compile", template, length, rc);
+    rc = test_reference(reference, &expected, &elength);
+    mustach_program_free(reference);
+    if (rc < 0)
+        return test_fail("mustach_exec2_mem", template, length, rc);
+
+    failures = 0;
+    rc = mustach_compile_inplace(template, length, &program);
+    if (rc < 0)
+        failures = test_fail("mustach_compile_inplace", template, length, rc);
+    else {
+        failures += check_texts(program, template, length);
+        test_context_init(&context);
+        rc = mustach_exec2_mem(program, &test_itf, &context, NULL, &result, &rlength);
+        if (rc < 0)
+            failures += test_fail("mustach_exec2_mem in place", template, length, rc);
+        else {
+            failures += test_compare("mustach_exec2_mem in place", template, length, expected, elength, result, rlength);
+            free(result);
+        }
+        mustach_program_free(program);
+    }
+
+    test_context_init(&context);
+    rc = mustach_mem(template, length, &test_itf1, &context, &result, &rlength);
+    if (rc < 0)
+        failures += test_fail("mustach_mem", template, length, rc);
+    else {
+        failures += test_compare("mustach_mem", template, length, expected, elength, result, rlength);
+        free(result);
+    }
+    free(expected);
+    return failures;
+}
+
+int mustach_tests_inplace(void)
+{
+    static const char *const names[] = { "inplace" };
+    struct mustach_program *program;
+    char template[TEST_LENGTH], *copy;
+    unsigned seed, i;
+    size_t length;
+    FILE *file;
+    int rc, failures;
+
+    failures = 0;
+    seed = 5;
+    for (i = 0 ; i < TEST_TEMPLATES ; i++) {
+        /* copied at the end of its block: no byte beyond 'length' is read */
+        length = test_template(&seed, template, sizeof template);
+        copy = malloc(length ? length : 1);
+        if (copy == NULL)
+            return failures + 1;
+        memcpy(copy, template, length);
+        failures += check(copy, length);
+        free(copy);
+    }
+
+    /* the programs compiled in place can't be archived */
+    rc = mustach_compile_inplace("{{name}}", 8, &program);
+    if (rc < 0)
+        return failures + test_fail("mustach_compile_inplace", "{{name}}", 8, rc);
+    file = tmpfile();
+    rc = file == NULL ? MUSTACH_ERROR_SYSTEM : mustach_archive_write(file, names, (const struct mustach_program *const*)&program, 1);
+    if (rc != MUSTACH_ERROR_BAD_ARCHIVE)
+        failures += test_fail("rejecting in mustach_archive_write", "{{name}}", 8, rc);
+    if (file != NULL)
+        fclose(file);
+    mustach_program_free(program);
+    return failures;
+}
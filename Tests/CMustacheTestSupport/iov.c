@@ -0,0 +1,122 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+
+#include "tests.h"
+
+/* renders 'program' with mustach_exec2_iov and concatenates its segments */
+static int render(const struct mustach_program *program, char **result, size_t *length)
+{
+    struct mustach_iov *iov;
+    struct test_context context;
+    const struct iovec *segments;
+    int rc, count, i;
+
+    *result = NULL;
+    test_context_init(&context);
+    rc = mustach_exec2_iov(program, &test_itf, &context, NULL, &iov);
+    if (rc < 0)
+        return rc;
+    segments = mustach_iov_segments(iov, &count);
+    *length = mustach_iov_length(iov);
+    *result = malloc(*length + 1);
+    if (*result == NULL)
+        rc = MUSTACH_ERROR_SYSTEM;
+    else {
+        *length = 0;
+        for (i = 0 ; i < count ; i++) {
+            memcpy(&(*result)[*length], segments[i].iov_base, segments[i].iov_len);
+            *length += segments[i].iov_len;
+        }
+        if (*length != mustach_iov_length(iov))
+            rc = MUSTACH_ERROR_SYSTEM;
+    }
+    mustach_iov_free(iov);
+    return rc;
+}
+
+/* renders 'program' with mustach_exec2_writev in a temporary file */
+static int render_writev(const struct mustach_program *program, char **result, size_t *length)
+{
+    struct test_context context;
+    FILE *file;
+    int rc;
+
+    *result = NULL;
+    file = tmpfile();
+    if (file == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    test_context_init(&context);
+    rc = mustach_exec2_writev(program, &test_itf, &context, NULL, fileno(file));
+    if (rc == MUSTACH_OK)
+        rc = test_contents(file, result, length);
+    fclose(file);
+    return rc;
+}
+
+static int check(const char *template, size_t length)
+{
+    struct mustach_program *program;
+    char *expected, *result;
+    size_t elength, rlength;
+    int rc, failures;
+
+    rc = mustach_compile(template, length, &program);
+    if (rc < 0)
+        return test_fail("mustach_compile", template, length, rc);
+    rc = test_reference(program, &expected, &elength);
+    if (rc < 0) {
+        mustach_program_free(program);
+        return test_fail("mustach_exec2_mem", template, length, rc);
+    }
+
+    rc = render(program, &result, &rlength);
+    if (rc < 0)
+        failures = test_fail("mustach_exec2_iov", template, length, rc);
+    else
+        failures = test_compare("mustach_exec2_iov", template, length, expected, elength, result, rlength);
+    free(result);
+
+    rc = render_writev(program, &result, &rlength);
+    if (rc < 0)
+        failures += test_fail("mustach_exec2_writev", template, length, rc);
+    else
+        failures += test_compare("mustach_exec2_writev", template, length, expected, elength, result, rlength);
+    free(result);
+
+    free(expected);
+    mustach_program_free(program);
+    return failures;
+}
+
+int mustach_tests_iov(void)
+{
+    char template[TEST_LENGTH];
+    unsigned seed, i;
+    size_t length;
+    int failures;
+
+    failures = 0;
+    seed = 19;
+    for (i = 0 ; i < TEST_TEMPLATES ; i++) {
+        length = test_template(&seed, template, sizeof template);
+        failures += check(template, length);
+    }
+    return failures;
+}
@@ -0,0 +1,114 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tests.h"
+
+static const char template[] = "{{>p}}{{#list}}{{>p}}{{/list}}";
+
+/* renders the template with the partial 'p' of 'text', expects 'expected' after 'fetched' fetches */
+static int check(struct test_context *context, const struct mustach_program *program, struct mustach_options *options,
+                 const char *text, const char *expected, unsigned fetched)
+{
+    const char *partials[] = { "p", text, NULL };
+    char *result;
+    size_t length;
+    int rc, failures;
+
+    context->partials = partials;
+    context->depth = 1;
+    rc = mustach_exec2_mem(program, &test_itf, context, options, &result, &length);
+    if (rc < 0)
+        return test_fail("mustach_exec2_mem with a cache of partials", template, strlen(template), rc);
+    failures = test_compare("cached partials", template, strlen(template), expected, strlen(expected), result, length);
+    free(result);
+    if (context->fetched != fetched) {
+        fprintf(stderr, "the partials were fetched %u times instead of %u\n", context->fetched, fetched);
+        failures++;
+    }
+    return failures;
+}
+
+/* renders the partial 'name' given by 'get', its text changes with the context */
+static int check_context(struct test_context *context, struct mustach_options *options)
+{
+    static const char text[] = "{{>name}}{{#list}}{{>name}}{{/list}}{{>name}}";
+    static const char expected[] = "a & bx & y<b>a & b";
+    struct mustach_itf2 itf = test_itf;
+    struct mustach_program *program;
+    char *result;
+    size_t length;
+    int rc, failures;
+
+    rc = mustach_compile(text, strlen(text), &program);
+    if (rc < 0)
+        return test_fail("mustach_compile", text, strlen(text), rc);
+    itf.partial = NULL;
+    context->depth = 1;
+    rc = mustach_exec2_mem(program, &itf, context, options, &result, &length);
+    mustach_program_free(program);
+    if (rc < 0)
+        return test_fail("mustach_exec2_mem with partials given by get", text, strlen(text), rc);
+    failures = test_compare("partials given by get", text, strlen(text), expected, strlen(expected), result, length);
+    free(result);
+    return failures;
+}
+
+int mustach_tests_partials(void)
+{
+    struct mustach_program *program;
+    struct mustach_options options;
+    struct test_context context;
+    int rc, failures;
+
+    rc = mustach_compile(template, strlen(template), &program);
+    if (rc < 0)
+        return test_fail("mustach_compile", template, strlen(template), rc);
+    memset(&options, 0, sizeof options);
+    rc = mustach_partials_create(&options.partials);
+    if (rc < 0) {
+        mustach_program_free(program);
+        return test_fail("mustach_partials_create", template, strlen(template), rc);
+    }
+    test_context_init(&context);
+
+    /* fetched once, then kept across the renderings */
+    failures = check(&context, program, &options, "<{{id}}>", "<0><1><2><3>", 1);
+    failures += check(&context, program, &options, "({{id}})", "<0><1><2><3>", 1);
+
+    /* invalidating another partial keeps it */
+    mustach_partials_invalidate(options.partials, "q", 1);
+    failures += check(&context, program, &options, "({{id}})", "<0><1><2><3>", 1);
+
+    /* invalidated, it is fetched and compiled again */
+    mustach_partials_invalidate(options.partials, "p", 1);
+    failures += check(&context, program, &options, "({{id}})", "(0)(1)(2)(3)", 2);
+    mustach_partials_invalidate(options.partials, NULL, 0);
+    failures += check(&context, program, &options, "[{{id}}]", "[0][1][2][3]", 3);
+
+    /* without a cache, each rendering fetches it again */
+    failures += check(&context, program, NULL, "{{id}}", "0123", 4);
+
+    /* the partials given by 'get' are never kept */
+    failures += check_context(&context, NULL);
+    failures += check_context(&context, &options);
+
+    mustach_partials_free(options.partials);
+    mustach_program_free(program);
+    return failures;
+}
@@ -0,0 +1,175 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tests.h"
+
+/* status given to 'stop', 1 if not called */
+static int stopped;
+
+static int start_failing(void *closure)
+{
+    (void)closure; /* unused */
+    return MUSTACH_ERROR_USER(1);
+}
+
+static int start_stopping(void *closure)
+{
+    (void)closure; /* unused */
+    return 2;
+}
+
+static void stop(void *closure, int status)
+{
+    (void)closure; /* unused */
+    stopped = status;
+}
+
+/* renders 'program' by steps of random capacities, sometimes 0 */
+static int render(const struct mustach_program *program, unsigned *seed, char **result, size_t *length)
+{
+    struct mustach_render *render;
+    struct test_context context;
+    char chunk[512], *output;
+    size_t capacity, written;
+    int rc;
+
+    *result = NULL;
+    *length = 0;
+    test_context_init(&context);
+    rc = mustach_render_create(&render, program, &test_itf, &context, NULL);
+    if (rc < 0)
+        return rc;
+    do {
+        capacity = test_random(seed, 8) ? 1 + test_random(seed, test_random(seed, 2) ? 16 : sizeof chunk) : 0;
+        rc = mustach_step(render, chunk, capacity, &written);
+        if (capacity == 0) {
+            if (rc != MUSTACH_ERROR_TOO_SMALL || written != 0)
+                rc = MUSTACH_ERROR_SYSTEM;
+            else
+                rc = 1;
+        } else if (rc >= 0 && written) {
+            output = realloc(*result, *length + written);
+            if (output == NULL)
+                rc = MUSTACH_ERROR_SYSTEM;
+            else {
+                memcpy(&output[*length], chunk, written);
+                *result = output;
+                *length += written;
+            }
+        }
+    } while (rc == 1);
+    mustach_render_free(render);
+    return rc;
+}
+
+static int check(const char *template, size_t length, unsigned *seed)
+{
+    struct mustach_program *program;
+    char *expected, *result;
+    size_t elength, rlength;
+    int rc, failures;
+
+    rc = mustach_compile(template, length, &program);
+    if (rc < 0)
+        return test_fail("mustach_compile", template, length, rc);
+    rc = test_reference(program, &expected, &elength);
+    if (rc < 0) {
+        mustach_program_free(program);
+        return test_fail("mustach_exec2_mem", template, length, rc);
+    }
+    rc = render(program, seed, &result, &rlength);
+    if (rc < 0)
+        failures = test_fail("mustach_step", template, length, rc);
+    else
+        failures = test_compare("mustach_step", template, length, expected, elength, result, rlength);
+    free(result);
+    free(expected);
+    mustach_program_free(program);
+    return failures;
+}
+
+/* checks the calls of 'stop' when 'start' fails or stops and when released before the end */
+static int check_stop(void)
+{
+    static const char template[] = "{{#list}}{{name}}{{/list}}";
+    struct mustach_itf2 itf = test_itf;
+    struct mustach_program *program;
+    struct mustach_render *render;
+    struct test_context context;
+    char chunk[1];
+    size_t written;
+    int rc, failures = 0;
+
+    rc = mustach_compile(template, strlen(template), &program);
+    if (rc < 0)
+        return test_fail("mustach_compile", template, strlen(template), rc);
+    itf.stop = stop;
+
+    itf.start = start_failing;
+    stopped = 1;
+    test_context_init(&context);
+    rc = mustach_render_create(&render, program, &itf, &context, NULL);
+    if (rc != MUSTACH_ERROR_USER(1) || render != NULL || stopped != rc)
+        failures += test_fail("stopping when 'start' fails", template, strlen(template), stopped);
+
+    /* a positive status of 'start' is returned, the rendering is complete */
+    itf.start = start_stopping;
+    stopped = 1;
+    test_context_init(&context);
+    rc = mustach_render_create(&render, program, &itf, &context, NULL);
+    if (rc != 2 || stopped != 2)
+        failures += test_fail("stopping when 'start' returns a positive status", template, strlen(template), stopped);
+    else {
+        stopped = 1;
+        rc = mustach_step(render, chunk, sizeof chunk, &written);
+        mustach_render_free(render);
+        if (rc != MUSTACH_OK || written != 0 || stopped != 1)
+            failures += test_fail("stepping a rendering stopped by 'start'", template, strlen(template), rc);
+    }
+
+    itf.start = NULL;
+    stopped = 1;
+    test_context_init(&context);
+    rc = mustach_render_create(&render, program, &itf, &context, NULL);
+    if (rc == MUSTACH_OK) {
+        rc = mustach_step(render, chunk, sizeof chunk, &written);
+        mustach_render_free(render);
+    }
+    if (rc != 1 || stopped != MUSTACH_ERROR_ABORTED)
+        failures += test_fail("stopping when released before the end", template, strlen(template), stopped);
+
+    mustach_program_free(program);
+    return failures;
+}
+
+int mustach_tests_step(void)
+{
+    char template[TEST_LENGTH];
+    unsigned seed, i;
+    size_t length;
+    int failures;
+
+    failures = 0;
+    seed = 14;
+    for (i = 0 ; i < TEST_TEMPLATES ; i++) {
+        length = test_template(&seed, template, sizeof template);
+        failures += check(template, length, &seed);
+    }
+    return failures + check_stop();
+}
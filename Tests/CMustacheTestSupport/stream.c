@@ -0,0 +1,117 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tests.h"
+
+/* a template read by pieces of random sizes */
+struct reader {
+    const char *template;
+    size_t length, offset;
+    unsigned *seed;
+};
+
+static int read_template(void *closure, char *buffer, size_t size, size_t *count)
+{
+    struct reader *reader = closure;
+    size_t n = 1 + test_random(reader->seed, test_random(reader->seed, 2) ? 8 : 1024);
+
+    if (n > size)
+        n = size;
+    if (n > reader->length - reader->offset)
+        n = reader->length - reader->offset;
+    memcpy(buffer, &reader->template[reader->offset], n);
+    reader->offset += n;
+    *count = n;
+    return MUSTACH_OK;
+}
+
+/* renders with mustach_stream or, if 'fd', with mustach_stream_fd */
+static int render(const char *template, size_t length, unsigned *seed, int fd, char **result, size_t *rlength)
+{
+    struct reader reader = { template, length, 0, seed };
+    struct test_context context;
+    FILE *input, *output;
+    int rc;
+
+    *result = NULL;
+    output = tmpfile();
+    if (output == NULL)
+        return MUSTACH_ERROR_SYSTEM;
+    test_context_init(&context);
+    if (!fd)
+        rc = mustach_stream(read_template, &reader, &test_itf, &context, NULL, output);
+    else {
+        input = tmpfile();
+        rc = MUSTACH_ERROR_SYSTEM;
+        if (input != NULL && fwrite(template, 1, length, input) == length && !fflush(input)
+         && lseek(fileno(input), 0, SEEK_SET) == 0)
+            rc = mustach_stream_fd(fileno(input), &test_itf, &context, NULL, output);
+        if (input != NULL)
+            fclose(input);
+    }
+    if (rc == MUSTACH_OK)
+        rc = test_contents(output, result, rlength);
+    fclose(output);
+    return rc;
+}
+
+static int check(const char *template, size_t length, unsigned *seed)
+{
+    struct mustach_program *program;
+    char *expected, *result;
+    size_t elength, rlength;
+    int rc, failures, fd;
+
+    rc = mustach_compile(template, length, &program);
+    if (rc < 0)
+        return test_fail("mustach_compile", template, length, rc);
+    rc = test_reference(program, &expected, &elength);
+    mustach_program_free(program);
+    if (rc < 0)
+        return test_fail("mustach_exec2_mem", template, length, rc);
+
+    failures = 0;
+    for (fd = 0 ; fd < 2 ; fd++) {
+        rc = render(template, length, seed, fd, &result, &rlength);
+        if (rc < 0)
+            failures += test_fail(fd ? "mustach_stream_fd" : "mustach_stream", template, length, rc);
+        else
+            failures += test_compare(fd ? "mustach_stream_fd" : "mustach_stream", template, length, expected, elength, result, rlength);
+        free(result);
+    }
+    free(expected);
+    return failures;
+}
+
+int mustach_tests_stream(void)
+{
+    char template[TEST_LENGTH];
+    unsigned seed, i;
+    size_t length;
+    int failures;
+
+    failures = 0;
+    seed = 15;
+    for (i = 0 ; i < TEST_TEMPLATES ; i++) {
+        length = test_template(&seed, template, sizeof template);
+        failures += check(template, length, &seed);
+    }
+    return failures;
+}
@@ -0,0 +1,87 @@
+/*
+ Tests of the mustach engine.
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+*/
+
+#ifndef _tests_h_included_
+#define _tests_h_included_
+#include <stdio.h>
+
+#include "mustach.h"
+#include "mustach_tests.h"
+
+/* count of random templates rendered by each check */
+#define TEST_TEMPLATES 1000
+
+/* maximum length of the random templates */
+#define TEST_LENGTH 4096
+
+/**
+ * test_value - a fixed tree of data for rendering
+ *
+ * @type:   one of TEST_STRING, TEST_OBJECT, TEST_ARRAY
+ * @string: the value of TEST_STRING
+ * @count:  count of fields of TEST_OBJECT or of items of TEST_ARRAY
+ * @names:  names of the fields of TEST_OBJECT
+ * @items:  values of the fields of TEST_OBJECT or items of TEST_ARRAY
+ */
+struct test_value {
+    enum { TEST_STRING, TEST_OBJECT, TEST_ARRAY } type;
+    const char *string;
+    size_t count;
+    const char *const *names;
+    const struct test_value *items;
+};
+
+/**
+ * test_context - closure of 'test_itf' rendering the test data
+ *
+ * @partials: the texts of the partials, pairs of name and text ended by
+ *            NULL, the other partials are empty
+ * @fetched:  count of calls to the callback 'partial'
+ */
+struct test_context {
+    struct { const struct test_value *value; size_t index; } stack[MUSTACH_MAX_DEPTH];
+    int depth;
+    const char *const *partials;
+    unsigned fetched;
+};
+
+/* interfaces rendering a test_context, of version 2 and historic */
+extern struct mustach_itf2 test_itf;
+extern struct mustach_itf test_itf1;
+
+/* prepares 'context' for rendering the test data with the default partials */
+extern void test_context_init(struct test_context *context);
+
+/* returns a random number of 'seed' below 'count' */
+extern unsigned test_random(unsigned *seed, unsigned count);
+
+/* writes in 'buffer' of 'size' bytes a random template of 'seed', returns its length */
+extern size_t test_template(unsigned *seed, char *buffer, size_t size);
+
+/* renders in 'result' the 'program' with mustach_exec2_mem and the test data */
+extern int test_reference(const struct mustach_program *program, char **result, size_t *length);
+
+/* reads in 'result' the whole content of 'file', to be freed even in case of error */
+extern int test_contents(FILE *file, char **result, size_t *length);
+
+/* reports a failure of 'what' about 'template' and returns 1 */
+extern int test_fail(const char *what, const char *template, size_t length, int rc);
+
+/* compares 'result' of 'length' with 'expected', reports and returns 1 if different */
+extern int test_compare(const char *what, const char *template, size_t tlength,
+                        const char *expected, size_t elength, const char *result, size_t length);
+
+#endif
@@ -0,0 +1,38 @@
+import XCTest
+import CMustacheTestSupport
+
+/// Runs the checks of the C engine, their failures are described on the
+/// standard error
+final class CMustacheTests: XCTestCase {
+    func testPartials() {
+        XCTAssertEqual(mustach_tests_partials(), 0)
+    }
+
+    func testInplace() {
+        XCTAssertEqual(mustach_tests_inplace(), 0)
+    }
+
+    func testDepth() {
+        XCTAssertEqual(mustach_tests_depth(), 0)
+    }
+
+    func testStep() {
+        XCTAssertEqual(mustach_tests_step(), 0)
+    }
+
+    func testStream() {
+        XCTAssertEqual(mustach_tests_stream(), 0)
+    }
+
+    func testArchive() {
+        XCTAssertEqual(mustach_tests_archive(), 0)
+    }
+
+    func testIov() {
+        XCTAssertEqual(mustach_tests_iov(), 0)
+    }
+
+    func testFd() {
+        XCTAssertEqual(mustach_tests_fd(), 0)
+    }
+}
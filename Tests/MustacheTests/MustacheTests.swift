@@ -1,4 +1,6 @@
+import Foundation
 import XCTest
+import CMustache
 @testable import Mustache
 
 final class MustacheTests: XCTestCase {
@@ -22,6 +24,12 @@ final class MustacheTests: XCTestCase {
         }
     }
 
+    func testErrorStatus() {
+        XCTAssertEqual(MustacheError(status: MUSTACH_ERROR_TOO_DEEP), .tooDeep)
+        XCTAssertEqual(MustacheError(status: MUSTACH_ERROR_USER_BASE - 1), .other(MUSTACH_ERROR_USER_BASE - 1))
+        XCTAssertEqual(MustacheError(status: -42).description, "Mustache error: status -42")
+    }
+
     func testSectionValue() throws {
         let result = try MustacheRenderer().render(
             template: "{{#repo}}<b>{{name}}</b>{{/repo}}",
@@ -61,4 +69,297 @@ final class MustacheTests: XCTestCase {
         )
         XCTAssertEqual(result, "<b>vapor/vapor</b><b>abc</b><b>def</b><b>vapor/fluent</b>")
     }
+
+    func testSectionArrayWithDelimiters() throws {
+        let result = try MustacheRenderer().render(
+            template: "{{#repo}}{{=<% %>=}}<b><%name%></b><%/repo%>",
+            data: ["repo": [
+                ["name": "vapor/vapor"],
+                ["name": "vapor/fluent"]
+            ]]
+        )
+        XCTAssertEqual(result, "<b>vapor/vapor</b><b>vapor/fluent</b>")
+    }
+
+    func testDelimitersWithSpaces() throws {
+        let result = try MustacheRenderer().render(
+            template: "{{= <% %> =}}Hello, <% name %>!",
+            data: ["name": "Vapor"]
+        )
+        XCTAssertEqual(result, "Hello, Vapor!")
+    }
+
+    func testBytesTemplate() throws {
+        let template = Array("Hello, {{name}}! trailing bytes are ignored".utf8)
+        let result = try template.withUnsafeBytes { bytes in
+            try MustacheRenderer().render(
+                template: UnsafeRawBufferPointer(rebasing: bytes[..<16]),
+                data: ["name": "Vapor"]
+            )
+        }
+        XCTAssertEqual(result, "Hello, Vapor!")
+        XCTAssertEqual(try MustacheRenderer().render(template: template, data: ["name": "Vapor"]),
+                       "Hello, Vapor! trailing bytes are ignored")
+    }
+
+    func testEscaping() throws {
+        let result = try MustacheRenderer().render(
+            template: "{{html}} {{{html}}} {{&html}}",
+            data: ["html": "<a&b>"]
+        )
+        XCTAssertEqual(result, "&lt;a&amp;b&gt; <a&b> <a&b>")
+
+        let template = try MustacheTemplate(
+            "{{#items}}{{>item}}{{/items}}{{user.name}}",
+            partials: ["item": "{{name}}{{=<% %>=}}<%name%><%&name%>"]
+        )
+        let data: [String: MustacheData] = ["items": [["name": "<i>"]], "user": ["name": "\"a\" & 'b'"]]
+        XCTAssertEqual(try template.render(data: data), "&lt;i&gt;&lt;i&gt;<i>\"a\" &amp; 'b'")
+    }
+
+    func testSymbols() throws {
+        var program: OpaquePointer?
+        let template = "{{#repo}}{{name}}{{/repo}}{{name}}{{> name}}"
+        XCTAssertEqual(template.withCString { mustach_compile($0, strlen($0), &program) }, MUSTACH_OK)
+        defer { mustach_program_free(program) }
+        var context = MustacheContext(data: ["repo": [["name": "a"], [:]], "name": "top"], program: program!)
+        XCTAssertEqual(context.symbols, ["repo", "name"])
+
+        XCTAssertEqual(context.string(of: context.get(symbol: 1)), "top")
+        XCTAssertTrue(context.enter(data: context.get(symbol: 0)))
+        XCTAssertEqual(context.string(of: context.get(symbol: 1)), "a")
+        XCTAssertTrue(context.next())
+        XCTAssertEqual(context.string(of: context.get(symbol: 1)), "top")
+        context.leave()
+        XCTAssertEqual(context.string(of: context.get(symbol: 1)), "top")
+    }
+
+    func testTemplate() throws {
+        let template = try MustacheTemplate("<b>{{name}}</b>")
+        XCTAssertEqual(try template.render(data: ["name": "vapor"]), "<b>vapor</b>")
+        XCTAssertEqual(try MustacheRenderer().render(template: template, data: ["name": "fluent"]), "<b>fluent</b>")
+    }
+
+    func testTemplatePartials() throws {
+        let template = try MustacheTemplate(
+            "{{>header}}{{#items}}{{>item}}{{/items}}",
+            partials: [
+                "header": "<h1>{{title}}</h1>",
+                "item": "<li>{{name}}{{#children}}<ul>{{>item}}</ul>{{/children}}</li>",
+            ]
+        )
+        let result = try template.render(data: [
+            "title": "List",
+            "items": [
+                ["name": "a", "children": [["name": "b", "children": "false"]]],
+            ],
+        ])
+        XCTAssertEqual(result, "<h1>List</h1><li>a<ul><li>b</li></ul></li>")
+    }
+
+    func testDataPartials() throws {
+        let result = try MustacheRenderer().render(
+            template: "{{>row}}{{#items}}{{>row}}{{/items}}",
+            data: ["row": "<h1>{{title}}</h1>", "title": "List", "items": [
+                ["row": "<li>{{name}}</li>", "name": "a"],
+                ["row": "<li>{{name}}!</li>", "name": "b"],
+            ]]
+        )
+        XCTAssertEqual(result, "<h1>List</h1><li>a</li><li>b!</li>")
+    }
+
+    func testTemplateCache() throws {
+        let probe = MustacheCache()
+        _ = try probe.template(named: "a") { "{{a}}" }
+        let size = probe.size
+        XCTAssertGreaterThan(size, try MustacheTemplate("{{a}}").size)
+        let cache = MustacheCache(capacity: 2 * size)
+        let renderer = MustacheRenderer(cache: cache)
+        var compiled = 0
+        let source = { () -> String in
+            compiled += 1
+            return "{{a}}"
+        }
+        XCTAssertEqual(try renderer.render(named: "a", data: ["a": "1"], source: source), "1")
+        XCTAssertEqual(try renderer.render(named: "a", data: ["a": "2"], source: source), "2")
+        XCTAssertEqual(compiled, 1)
+
+        _ = try cache.template(named: "b", source: source)
+        _ = try cache.template(named: "a", source: source)
+        _ = try cache.template(named: "c", source: source)
+        XCTAssertEqual(cache.count, 2)
+        XCTAssertLessThanOrEqual(cache.size, cache.capacity)
+        XCTAssertEqual(compiled, 3)
+        // "b" was the least recently used
+        _ = try cache.template(named: "a", source: source)
+        XCTAssertEqual(compiled, 3)
+        _ = try cache.template(named: "b", source: source)
+        XCTAssertEqual(compiled, 4)
+
+        cache.removeTemplate(named: "b")
+        XCTAssertEqual(cache.count, 1)
+        cache.removeAll()
+        XCTAssertEqual(cache.size, 0)
+
+        // the sources used as keys are counted
+        let source = "{{a}}" + String(repeating: " ", count: 4096)
+        _ = try probe.template(for: source)
+        XCTAssertGreaterThan(probe.size, size + 2 * 4096)
+
+        // and the partials kept by the templates, inlined once in the program
+        let partials = try MustacheTemplate("{{>p}}", partials: ["p": "x{{>p}}" + String(repeating: " ", count: 4096)])
+        XCTAssertGreaterThan(partials.size, 2 * 4096)
+    }
+
+    func testDottedNames() throws {
+        let result = try MustacheRenderer().render(
+            template: "{{repo.owner.name}} {{#repo.owner}}{{name}}{{/repo.owner}} {{^repo.missing}}none{{/repo.missing}}{{repo.owner.missing}}",
+            data: ["repo": ["owner": ["name": "vapor"]]]
+        )
+        XCTAssertEqual(result, "vapor vapor none")
+    }
+
+    func testRenderInto() throws {
+        let template = try MustacheTemplate("<p>{{name}}</p>{{#items}}<i>{{id}}</i>{{/items}}")
+        let data: [String: MustacheData] = ["name": "a & b", "items": [["id": "1"], ["id": "é"]]]
+        let expected = "<p>a &amp; b</p><i>1</i><i>é</i>"
+        XCTAssertEqual(try template.render(data: data), expected)
+
+        var bytes: [UInt8] = Array("> ".utf8)
+        try template.render(data: data, into: &bytes)
+        XCTAssertEqual(bytes, Array(("> " + expected).utf8))
+
+        var string = "> "
+        try template.render(data: data, into: &string)
+        XCTAssertEqual(string, "> " + expected)
+
+        let buffer = MustacheBuffer(capacity: 16)
+        try template.render(data: data, into: buffer)
+        try template.render(data: data, into: buffer)
+        XCTAssertEqual(buffer.string, expected)
+    }
+
+    func testOutputStreams() throws {
+        struct Failing: MustacheOutputStream {
+            var written = 0
+            mutating func write(_ bytes: UnsafeRawBufferPointer) throws {
+                guard self.written == 0 else {
+                    throw MustacheError.tooSmall
+                }
+                self.written += bytes.count
+            }
+        }
+        struct Collecting: MustacheOutputStream {
+            var renderings: [[UInt8]] = []
+            mutating func write(_ bytes: UnsafeRawBufferPointer) {
+                XCTFail("the pieces are collected")
+            }
+            mutating func write(expecting count: Int, rendering render: (_ write: (UnsafeRawBufferPointer) throws -> Void) throws -> Void) throws {
+                var bytes: [UInt8] = []
+                try render { piece in bytes.append(contentsOf: piece) }
+                self.renderings.append(bytes)
+            }
+        }
+        let template = try MustacheTemplate("<p>{{name}}</p>{{#items}}<i>{{id}}</i>{{/items}}")
+        let data: [String: MustacheData] = ["name": "a & b", "items": [["id": "1"], ["id": "é"]]]
+        let expected = "<p>a &amp; b</p><i>1</i><i>é</i>"
+
+        var counting = MustacheCountingOutput()
+        try template.render(data: data, into: &counting)
+        XCTAssertEqual(counting.count, expected.utf8.count)
+
+        var collecting = Collecting()
+        try template.render(data: data, into: &collecting)
+        try template.render(data: data, into: &collecting)
+        XCTAssertEqual(collecting.renderings, [Array(expected.utf8), Array(expected.utf8)])
+
+        let path = NSTemporaryDirectory() + "/mustache-\(UUID().uuidString)"
+        XCTAssertTrue(FileManager.default.createFile(atPath: path, contents: nil))
+        defer { try? FileManager.default.removeItem(atPath: path) }
+        let handle = try XCTUnwrap(FileHandle(forWritingAtPath: path))
+        let file = MustacheFileOutput(handle: handle, capacity: 8)
+        var output = file
+        try template.render(data: data, into: &output)
+        try template.render(data: data, into: &output)
+        try file.flush()
+        handle.closeFile()
+        XCTAssertEqual(FileManager.default.contents(atPath: path), Data((expected + expected).utf8))
+
+        var failing = Failing()
+        XCTAssertThrowsError(try template.render(data: data, into: &failing)) { error in
+            XCTAssertEqual(error as? MustacheError, .tooSmall)
+        }
+    }
+
+    func testSizeHint() throws {
+        let template = try MustacheTemplate("Hello {{name}}!{{#items}}, {{id}}{{/items}}")
+        XCTAssertEqual(template.sizeHint, 9)
+        XCTAssertEqual(try template.render(data: ["name": "world", "items": [["id": "a"], ["id": "b"], ["id": "c"]]]), "Hello world!, a, b, c")
+        XCTAssertGreaterThanOrEqual(template.sizeHint, 21)
+    }
+
+    func testScopePartials() throws {
+        let text = "<{{name}}>{{#items}}({{id}}){{/items}}"
+        var scope = MustacheScope(data: ["p": .string(text), "name": "x", "items": [["id": "1"], ["id": "2"]]])
+        try scope.partial("p")
+        let count = MustacheScope.partials.count
+        XCTAssertTrue(scope.enter("items"))
+        try scope.partial("p")
+        scope.leave()
+        try scope.partial("missing")
+        XCTAssertEqual(scope.output, "<x>(1)(2)<x>(1)(2)")
+        XCTAssertEqual(MustacheScope.partials.count, count)
+        XCTAssertTrue(try MustacheScope.partials.template(for: text) === MustacheScope.partials.template(for: text))
+    }
+
+    #if compiler(>=5.6)
+    func testGeneratedTemplates() throws {
+        let data: [String: MustacheData] = [
+            "title": "List",
+            "items": [
+                ["name": "a & b", "children": [["name": "c", "children": "false"]]],
+                ["name": "d"],
+            ],
+            "user": ["name": "vapor"],
+            "raw": "<i>",
+        ]
+        let interpreted = try MustacheTemplate(
+            "<h1>{{title}}</h1>\n{{#items}}{{>item}}{{/items}}{{^items}}none{{/items}}\n{{user.name}} {{{raw}}} {{raw}}",
+            partials: ["item": "<li>{{name}}{{#children}}<ul>{{>item}}</ul>{{/children}}</li>"]
+        ).render(data: data)
+        let generated = try MustacheTemplates.page(data)
+        XCTAssertEqual(generated, "<h1>List</h1>\n<li>a &amp; b<ul><li>c</li></ul></li><li>d</li>\nvapor <i> &lt;i&gt;")
+        XCTAssertEqual(generated, interpreted)
+        XCTAssertEqual(try MustacheTemplates.page(["items": [:]]), "<h1></h1>\n<li></li>\n  ")
+    }
+    #endif
+}
+
+#if compiler(>=5.5) && canImport(_Concurrency)
+@available(macOS 10.15, *)
+extension MustacheTests {
+    func testChunks() async throws {
+        let template = try MustacheTemplate("<ul>{{#items}}<li>{{id}}</li>{{/items}}</ul>")
+        let data: [String: MustacheData] = ["items": .array((0..<100).map { ["id": .string("\($0)")] })]
+        let expected = try template.render(data: data)
+
+        var bytes: [UInt8] = []
+        var sizes: [Int] = []
+        for try await chunk in template.chunks(data: data, size: 7) {
+            bytes += chunk
+            sizes.append(chunk.count)
+        }
+        XCTAssertEqual(String(decoding: bytes, as: UTF8.self), expected)
+        XCTAssertTrue(sizes.dropLast().allSatisfy { $0 == 7 })
+        XCTAssertEqual(sizes.count, (expected.utf8.count + 6) / 7)
+
+        let recursive = try MustacheTemplate("{{>p}}", partials: ["p": "x{{>p}}"])
+        do {
+            for try await _ in recursive.chunks(data: [:], size: 16) {
+            }
+            XCTFail("rendered an endless recursion")
+        } catch {
+        }
+    }
 }
+#endif